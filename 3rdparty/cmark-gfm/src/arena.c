@@ -1,15 +1,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include "config.h"
 #include "cmark-gfm.h"
 #include "cmark-gfm-extension_api.h"
 
-static struct arena_chunk {
+struct arena_chunk {
   size_t sz, used;
   uint8_t push_point;
   void *ptr;
   struct arena_chunk *prev;
-} *A = NULL;
+};
+
+// Each thread has its own arena, so that documents can be parsed on
+// several threads at once, and so that resetting the arena on one thread
+// does not free memory still in use by another.
+static CMARK_THREAD_LOCAL struct arena_chunk *A = NULL;
 
 static struct arena_chunk *alloc_arena_chunk(size_t sz, struct arena_chunk *prev) {
   struct arena_chunk *c = (struct arena_chunk *)calloc(1, sizeof(*c));
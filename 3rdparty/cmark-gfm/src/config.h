@@ -23,6 +23,23 @@ extern "C" {
   #define CMARK_ATTRIBUTE(list)
 #endif
 
+/* Storage class for state that must not be shared between threads, so that
+   documents can be parsed on several threads at once.
+*/
+#ifndef CMARK_THREAD_LOCAL
+  #if defined(_MSC_VER)
+    #define CMARK_THREAD_LOCAL __declspec(thread)
+  #elif defined(__GNUC__) || defined(__clang__)
+    #define CMARK_THREAD_LOCAL __thread
+  #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+    #define CMARK_THREAD_LOCAL _Thread_local
+  #else
+    /* Without thread-local storage, concurrent parses would share the
+       arena and character tables and corrupt each other's memory. */
+    #error "cmark-gfm needs thread-local storage; define CMARK_THREAD_LOCAL for this compiler"
+  #endif
+#endif
+
 #ifndef CMARK_INLINE
   #if defined(_MSC_VER) && !defined(__cplusplus)
     #define CMARK_INLINE __inline
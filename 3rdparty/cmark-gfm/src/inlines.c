@@ -57,8 +57,9 @@ typedef struct subject{
   bool scanned_for_backticks;
 } subject;
 
-// Extensions may populate this.
-static int8_t SKIP_CHARS[256];
+// Extensions may populate this.  Thread-local, since the characters of the
+// extensions attached to the parser are added and removed for each parse.
+static CMARK_THREAD_LOCAL int8_t SKIP_CHARS[256];
 
 static CMARK_INLINE bool S_is_line_end_char(char c) {
   return (c == '\n' || c == '\r');
@@ -1283,7 +1284,7 @@ static cmark_node *handle_newline(subject *subj) {
 }
 
 // "\r\n\\`&_*[]<!"
-static int8_t SPECIAL_CHARS[256] = {
+static CMARK_THREAD_LOCAL int8_t SPECIAL_CHARS[256] = {
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
       0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0,
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -92,6 +92,7 @@ INCLUDEPATH += src src/spelling
 HEADERS += \
     src/abstractstatisticswidget.h \
     src/appsettings.h \
+    src/backgroundspellchecker.h \
     src/cmarkgfmapi.h \
     src/cmarkgfmexporter.h \
     src/colorscheme.h \
@@ -105,7 +106,9 @@ HEADERS += \
     src/exporter.h \
     src/exporterfactory.h \
     src/exportformat.h \
+    src/htmlblockobserver.h \
     src/htmlpreview.h \
+    src/linerangeset.h \
     src/localedialog.h \
     src/mainwindow.h \
     src/markdowndocument.h \
@@ -114,6 +117,7 @@ HEADERS += \
     src/markdownhighlighter.h \
     src/markdownast.h \
     src/markdownnode.h \
+    src/markdownparser.h \
     src/markdownstates.h \
     src/memoryarena.h \
     src/messageboxhelper.h \
@@ -134,6 +138,8 @@ HEADERS += \
     src/themerepository.h \
     src/themeselectiondialog.h \
     src/timelabel.h \
+    src/utf8columnmap.h \
+    src/wordtokenizer.h \
     src/findreplace.h \
     src/color_button.h \
     src/spelling/abstract_dictionary.h \
@@ -146,6 +152,7 @@ SOURCES += \
     src/abstractstatisticswidget.cpp \
     src/appmain.cpp \
     src/appsettings.cpp \
+    src/backgroundspellchecker.cpp \
     src/cmarkgfmapi.cpp \
     src/cmarkgfmexporter.cpp \
     src/colorschemepreviewer.cpp \
@@ -158,7 +165,9 @@ SOURCES += \
     src/exporter.cpp \
     src/exporterfactory.cpp \
     src/exportformat.cpp \
+    src/htmlblockobserver.cpp \
     src/htmlpreview.cpp \
+    src/linerangeset.cpp \
     src/localedialog.cpp \
     src/mainwindow.cpp \
     src/markdowndocument.cpp \
@@ -166,6 +175,7 @@ SOURCES += \
     src/markdownhighlighter.cpp \
     src/markdownast.cpp \
     src/markdownnode.cpp \
+    src/markdownparser.cpp \
     src/memoryarena.cpp \
     src/messageboxhelper.cpp \
     src/outlinewidget.cpp \
@@ -184,6 +194,8 @@ SOURCES += \
     src/themerepository.cpp \
     src/themeselectiondialog.cpp \
     src/timelabel.cpp \
+    src/utf8columnmap.cpp \
+    src/wordtokenizer.cpp \
     src/color_button.cpp \
     src/findreplace.cpp \
     src/spelling/dictionary_manager.cpp \
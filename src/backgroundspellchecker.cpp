@@ -0,0 +1,500 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringRef>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "backgroundspellchecker.h"
+#include "spelling/dictionary_manager.h"
+
+namespace ghostwriter
+{
+/**
+ * The misspelled words found in a text with the dictionary of the
+ * given generation.
+ */
+typedef struct CheckResult
+{
+    QString text;
+    int generation;
+    QVector<MisspelledWord> words;
+} CheckResult;
+
+/**
+ * The spelling suggestions found for a word with the dictionary of the
+ * given generation.
+ */
+typedef struct SuggestionResult
+{
+    QString word;
+    int generation;
+    QStringList suggestions;
+} SuggestionResult;
+
+class BackgroundSpellCheckerThread;
+
+class BackgroundSpellCheckerPrivate
+{
+    Q_DECLARE_PUBLIC(BackgroundSpellChecker)
+
+public:
+    BackgroundSpellCheckerPrivate
+    (
+        BackgroundSpellChecker *q_ptr,
+        const DictionaryRef &dictionary
+    )
+        : q_ptr(q_ptr),
+          dictionary(dictionary),
+          generation(0),
+          resultsPosted(false),
+          stopRequested(false),
+          cache(MaxCacheCost),
+          suggestionCache(MaxCachedSuggestions)
+    {
+        ;
+    }
+
+    ~BackgroundSpellCheckerPrivate()
+    {
+        ;
+    }
+
+    // Cost of the cached results, in number of texts plus number of
+    // misspelled words, after which the least recently used results
+    // are dropped.
+    //
+    static const int MaxCacheCost = 100000;
+
+    // Number of words whose suggestions are cached.
+    static const int MaxCachedSuggestions = 256;
+
+    BackgroundSpellChecker *q_ptr;
+    BackgroundSpellCheckerThread *thread;
+
+    // Shared between the GUI and checker threads.  Guarded by mutex.
+    // The generation is incremented whenever the dictionary changes, so
+    // that results found with a prior dictionary can be told apart.
+    //
+    QMutex mutex;
+    QWaitCondition requestQueued;
+    DictionaryRef dictionary;
+    int generation;
+    QList<QString> requests;
+    QVector<CheckResult> results;
+    QList<QString> suggestionRequests;
+    QList<QString> suggestionPrefetches;
+    QVector<SuggestionResult> suggestionResults;
+    QWaitCondition suggestionsFound;
+    bool resultsPosted;
+    bool stopRequested;
+
+    // Accessed only by the GUI thread.  Results are cached by the
+    // checked text itself, which is implicitly shared with the blocks.
+    //
+    QCache<QString, CheckResult> cache;
+    QHash<QString, QVector<QTextBlock>> pendingBlocks;
+    QCache<QString, SuggestionResult> suggestionCache;
+    QSet<QString> pendingSuggestions;
+    QString requestedSuggestionsWord;
+
+    void run();
+    static QVector<MisspelledWord> check(const DictionaryRef &dictionary, const QString &text);
+};
+
+const int BackgroundSpellCheckerPrivate::MaxCacheCost;
+const int BackgroundSpellCheckerPrivate::MaxCachedSuggestions;
+
+/**
+ * Thread that runs the spell checker's request loop.
+ */
+class BackgroundSpellCheckerThread : public QThread
+{
+public:
+    BackgroundSpellCheckerThread(BackgroundSpellCheckerPrivate *checker)
+        : checker(checker)
+    {
+        ;
+    }
+
+protected:
+    void run()
+    {
+        checker->run();
+    }
+
+private:
+    BackgroundSpellCheckerPrivate *checker;
+};
+
+BackgroundSpellChecker::BackgroundSpellChecker
+(
+    const DictionaryRef &dictionary,
+    QObject *parent
+) : QObject(parent),
+    d_ptr(new BackgroundSpellCheckerPrivate(this, dictionary))
+{
+    Q_D(BackgroundSpellChecker);
+
+    connect
+    (
+        &DictionaryManager::instance(),
+        &DictionaryManager::changed,
+        this,
+        &BackgroundSpellChecker::invalidate
+    );
+
+    d->thread = new BackgroundSpellCheckerThread(d);
+    d->thread->start(QThread::LowPriority);
+}
+
+BackgroundSpellChecker::~BackgroundSpellChecker()
+{
+    Q_D(BackgroundSpellChecker);
+
+    d->mutex.lock();
+    d->stopRequested = true;
+    d->requestQueued.wakeAll();
+    d->mutex.unlock();
+
+    d->thread->wait();
+    delete d->thread;
+    d->thread = nullptr;
+}
+
+void BackgroundSpellChecker::setDictionary(const DictionaryRef &dictionary)
+{
+    Q_D(BackgroundSpellChecker);
+
+    {
+        QMutexLocker locker(&d->mutex);
+        d->dictionary = dictionary;
+    }
+
+    invalidate();
+}
+
+bool BackgroundSpellChecker::misspelledWords
+(
+    const QTextBlock &block,
+    const QString &text,
+    bool prioritize,
+    QVector<MisspelledWord> &words
+)
+{
+    Q_D(BackgroundSpellChecker);
+
+    const CheckResult *cached = d->cache.object(text);
+
+    words.clear();
+
+    if (nullptr != cached) {
+        words = cached->words;
+
+        if (d->generation == cached->generation) {
+            return true;
+        }
+    }
+
+    // Blocks with the same text share one check.
+    QVector<QTextBlock> &blocks = d->pendingBlocks[text];
+    bool queued = !blocks.isEmpty();
+
+    if (!blocks.contains(block)) {
+        blocks.append(block);
+    }
+
+    QMutexLocker locker(&d->mutex);
+
+    if (!queued) {
+        if (prioritize) {
+            d->requests.prepend(text);
+        } else {
+            d->requests.append(text);
+        }
+
+        d->requestQueued.wakeOne();
+    } else if (prioritize) {
+        for (int i = 1; i < d->requests.size(); i++) {
+            if (text == d->requests[i]) {
+                d->requests.move(i, 0);
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+void BackgroundSpellChecker::invalidate()
+{
+    Q_D(BackgroundSpellChecker);
+
+    {
+        QMutexLocker locker(&d->mutex);
+
+        d->generation++;
+        d->requests.clear();
+        d->suggestionRequests.clear();
+        d->suggestionPrefetches.clear();
+    }
+
+    d->pendingBlocks.clear();
+    d->pendingSuggestions.clear();
+    d->requestedSuggestionsWord.clear();
+    emit invalidated();
+}
+
+bool BackgroundSpellChecker::suggestions
+(
+    const QString &word,
+    QStringList &suggestions,
+    int timeout
+)
+{
+    Q_D(BackgroundSpellChecker);
+
+    const SuggestionResult *cached = d->suggestionCache.object(word);
+
+    suggestions.clear();
+
+    if ((nullptr != cached) && (d->generation == cached->generation)) {
+        suggestions = cached->suggestions;
+        return true;
+    }
+
+    QMutexLocker locker(&d->mutex);
+
+    // Only the most recently requested word is still wanted, so any
+    // prior one yet to be looked up is dropped.
+    //
+    if
+    (
+        !d->requestedSuggestionsWord.isEmpty() &&
+        (word != d->requestedSuggestionsWord) &&
+        d->suggestionRequests.removeOne(d->requestedSuggestionsWord)
+    ) {
+        d->pendingSuggestions.remove(d->requestedSuggestionsWord);
+    }
+
+    // Move the word ahead of any other work, unless it is already
+    // being looked up.
+    //
+    bool queued =
+        d->suggestionPrefetches.removeOne(word) ||
+        d->suggestionRequests.removeOne(word);
+
+    if (queued || !d->pendingSuggestions.contains(word)) {
+        d->suggestionRequests.prepend(word);
+        d->pendingSuggestions.insert(word);
+        d->requestQueued.wakeOne();
+    }
+
+    d->requestedSuggestionsWord = word;
+
+    if (timeout <= 0) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    forever {
+        foreach (const SuggestionResult &result, d->suggestionResults) {
+            if ((word == result.word) && (d->generation == result.generation)) {
+                suggestions = result.suggestions;
+                return true;
+            }
+        }
+
+        qint64 remaining = timeout - timer.elapsed();
+
+        if (remaining <= 0) {
+            return false;
+        }
+
+        d->suggestionsFound.wait(&d->mutex, (unsigned long) remaining);
+    }
+}
+
+void BackgroundSpellChecker::prefetchSuggestions(const QString &word)
+{
+    Q_D(BackgroundSpellChecker);
+
+    const SuggestionResult *cached = d->suggestionCache.object(word);
+
+    if
+    (
+        ((nullptr != cached) && (d->generation == cached->generation)) ||
+        d->pendingSuggestions.contains(word)
+    ) {
+        return;
+    }
+
+    QMutexLocker locker(&d->mutex);
+
+    d->suggestionPrefetches.append(word);
+    d->pendingSuggestions.insert(word);
+    d->requestQueued.wakeOne();
+}
+
+void BackgroundSpellChecker::onResultsReady()
+{
+    Q_D(BackgroundSpellChecker);
+
+    QVector<CheckResult> results;
+    QVector<SuggestionResult> suggestionResults;
+    int generation;
+
+    {
+        QMutexLocker locker(&d->mutex);
+
+        results.swap(d->results);
+        suggestionResults.swap(d->suggestionResults);
+        d->resultsPosted = false;
+        generation = d->generation;
+    }
+
+    foreach (const SuggestionResult &result, suggestionResults) {
+        if (generation != result.generation) {
+            continue;
+        }
+
+        d->suggestionCache.insert(result.word, new SuggestionResult(result));
+        d->pendingSuggestions.remove(result.word);
+
+        if (result.word == d->requestedSuggestionsWord) {
+            d->requestedSuggestionsWord.clear();
+        }
+
+        emit suggestionsReady(result.word, result.suggestions);
+    }
+
+    QVector<QTextBlock> checkedBlocks;
+
+    foreach (const CheckResult &result, results) {
+        if (generation != result.generation) {
+            continue;
+        }
+
+        d->cache.insert(result.text, new CheckResult(result), 1 + result.words.size());
+        checkedBlocks += d->pendingBlocks.take(result.text);
+    }
+
+    if (!checkedBlocks.isEmpty()) {
+        emit blocksChecked(checkedBlocks);
+    }
+}
+
+void BackgroundSpellCheckerPrivate::run()
+{
+    Q_Q(BackgroundSpellChecker);
+
+    QMutexLocker locker(&mutex);
+
+    forever {
+        while
+        (
+            requests.isEmpty() &&
+            suggestionRequests.isEmpty() &&
+            suggestionPrefetches.isEmpty() &&
+            !stopRequested
+        ) {
+            requestQueued.wait(&mutex);
+        }
+
+        if (stopRequested) {
+            return;
+        }
+
+        DictionaryRef requestDictionary = dictionary;
+
+        // Requested suggestions are for words the user is looking at,
+        // so they are found ahead of any checks.  Prefetched ones wait
+        // until all checks are done.
+        //
+        if (!suggestionRequests.isEmpty() || requests.isEmpty()) {
+            SuggestionResult result;
+
+            if (!suggestionRequests.isEmpty()) {
+                result.word = suggestionRequests.takeFirst();
+            } else {
+                result.word = suggestionPrefetches.takeFirst();
+            }
+
+            result.generation = generation;
+
+            locker.unlock();
+            result.suggestions = requestDictionary.suggestions(result.word);
+            locker.relock();
+
+            suggestionResults.append(result);
+            suggestionsFound.wakeAll();
+        } else {
+            CheckResult result;
+
+            result.text = requests.takeFirst();
+            result.generation = generation;
+
+            locker.unlock();
+            result.words = check(requestDictionary, result.text);
+            locker.relock();
+
+            results.append(result);
+        }
+
+        // Results that arrive while the GUI thread is busy are taken
+        // together in one batch.
+        //
+        if (!resultsPosted) {
+            resultsPosted = true;
+            QMetaObject::invokeMethod(q, "onResultsReady", Qt::QueuedConnection);
+        }
+    }
+}
+
+QVector<MisspelledWord> BackgroundSpellCheckerPrivate::check
+(
+    const DictionaryRef &dictionary,
+    const QString &text
+)
+{
+    QVector<MisspelledWord> words;
+    QStringRef misspelledWord = dictionary.check(text, 0);
+
+    while (!misspelledWord.isNull()) {
+        MisspelledWord word;
+        word.position = misspelledWord.position();
+        word.length = misspelledWord.length();
+        words.append(word);
+
+        misspelledWord = dictionary.check(text, word.position + word.length);
+    }
+
+    return words;
+}
+} // namespace ghostwriter
@@ -0,0 +1,148 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef BACKGROUND_SPELL_CHECKER_H
+#define BACKGROUND_SPELL_CHECKER_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+#include <QTextBlock>
+#include <QVector>
+
+#include "spelling/dictionary_ref.h"
+
+namespace ghostwriter
+{
+/**
+ * A misspelled word, given by its position and length within the text
+ * of the block in which it was found.
+ */
+typedef struct MisspelledWord
+{
+    int position;
+    int length;
+} MisspelledWord;
+
+/**
+ * Spell checks the text of text blocks on a background thread, so that
+ * dictionary lookups are kept off of the GUI thread.  The misspelled words
+ * found are cached by the text in which they were found, so that each
+ * distinct text is checked only once until the dictionary changes.  Results are delivered to the GUI thread in batches.
+ *
+ * Spelling suggestions, which can take the dictionary far longer to find
+ * than checking text, are likewise looked up on the background thread
+ * and cached by word.
+ */
+class BackgroundSpellCheckerPrivate;
+class BackgroundSpellChecker : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(BackgroundSpellChecker)
+
+public:
+    /**
+     * Constructor.  Checks text with the given dictionary.
+     */
+    BackgroundSpellChecker(const DictionaryRef &dictionary, QObject *parent = nullptr);
+
+    /**
+     * Destructor.  Waits for any check in progress to finish.
+     */
+    ~BackgroundSpellChecker();
+
+    /**
+     * Sets the dictionary with which to check text.  Cached results
+     * become out of date, as with invalidate().
+     */
+    void setDictionary(const DictionaryRef &dictionary);
+
+    /**
+     * Looks up the misspelled words in the given text of the given block.
+     * Returns true if the words were found with the current dictionary.
+     * Otherwise, the words last found in the same text (if any) are
+     * returned while the text is queued to be checked, after which
+     * blocksChecked() is emitted for the block.  The text is checked
+     * ahead of any others waiting to be checked if prioritize is true.
+     */
+    bool misspelledWords
+    (
+        const QTextBlock &block,
+        const QString &text,
+        bool prioritize,
+        QVector<MisspelledWord> &words
+    );
+
+    /**
+     * Marks all cached results as out of date, such as for when words are
+     * added to the dictionary, and cancels any checks waiting to be done.
+     * This is done automatically when the DictionaryManager signals that
+     * the dictionaries have changed.
+     */
+    void invalidate();
+
+    /**
+     * Looks up spelling suggestions for the given word.  Returns true if
+     * the suggestions were found, either already cached or within the
+     * given timeout (in milliseconds).  Otherwise, the word is looked up
+     * ahead of any other work, replacing any word previously requested
+     * with this method that has yet to be looked up, and
+     * suggestionsReady() is emitted once its suggestions are found.
+     */
+    bool suggestions(const QString &word, QStringList &suggestions, int timeout = 0);
+
+    /**
+     * Looks up spelling suggestions for the given word once the checks
+     * and requested suggestions already waiting are done, so that they
+     * are cached should they be requested later.
+     */
+    void prefetchSuggestions(const QString &word);
+
+signals:
+    /**
+     * Emitted when the text of the given blocks has been checked, such
+     * that misspelledWords() returns their results.  The blocks may have
+     * changed or been removed since they were queued.
+     */
+    void blocksChecked(const QVector<QTextBlock> &blocks);
+
+    /**
+     * Emitted when the cached results have become out of date, and the
+     * blocks need to be checked again.
+     */
+    void invalidated();
+
+    /**
+     * Emitted when the suggestions for the given word have been found.
+     */
+    void suggestionsReady(const QString &word, const QStringList &suggestions);
+
+private slots:
+    /*
+     * Takes the results of the checks finished by the background thread.
+     */
+    void onResultsReady();
+
+private:
+    QScopedPointer<BackgroundSpellCheckerPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif
@@ -17,7 +17,14 @@
  *
  ***********************************************************************/
 
-#include <QMutex>
+#include <QByteArray>
+#include <QFuture>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QStringRef>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QVector>
 
 #include "3rdparty/cmark-gfm/src/cmark-gfm-extension_api.h"
 #include "3rdparty/cmark-gfm/extensions/cmark-gfm-core-extensions.h"
@@ -30,8 +37,6 @@ class CmarkGfmAPIPrivate
 {
 public:
 
-    static CmarkGfmAPI *instance;
-
     CmarkGfmAPIPrivate()
     {
         ;
@@ -49,18 +54,76 @@ public:
     cmark_syntax_extension *tagfilterExt;
     cmark_syntax_extension *tasklistExt;
 
-    QMutex apiMutex;
+    // Texts with fewer lines than this are parsed on a single thread.
+    static const int MinParallelParseLines = 10000;
+
+    // Minimum number of lines in each chunk of a parallel parse.
+    static const int MinChunkLines = 2500;
+
+    QRegularExpression referenceDefinitionRegex;
+    QRegularExpression nestedDefinitionRegex;
+    QRegularExpression footnoteDefinitionRegex;
+
+    /*
+    * Splits the given text into at most chunkCount chunks of roughly
+    * equal length for parsing in parallel.  Chunks start only at lines
+    * that follow a blank line outside of any fenced code block or HTML
+    * block, and that can't continue a list or indented code block.  The
+    * line number and text position at which each chunk starts are set,
+    * along with the text of every link reference definition and its
+    * line count, which must precede each chunk for links to resolve.
+    * Returns false if the text should not be parsed in chunks.
+    */
+    bool splitIntoChunks
+    (
+        const QString &text,
+        int chunkCount,
+        QVector<int> &chunkStartLines,
+        QVector<int> &chunkStarts,
+        QString &definitions,
+        int &definitionLineCount
+    ) const;
+
+    /*
+    * Returns the indentation in columns of the given line, expanding
+    * tabs to the next multiple of four columns.  The index of the first
+    * character that is not a space or tab is set.
+    */
+    static int indentation(const QStringRef &line, int &index);
+
+    /*
+    * Returns true if the line starts a fenced code block, setting the
+    * fence character and length if so.
+    */
+    static bool opensFence(const QStringRef &line, QChar &fenceChar, int &fenceLength);
+
+    /*
+    * Returns true if the line closes a fenced code block opened with the
+    * given fence character and length.
+    */
+    static bool closesFence(const QStringRef &line, QChar fenceChar, int fenceLength);
+
+    /*
+    * Returns the text that ends the HTML block started by the line, if
+    * the HTML block is one that a blank line does not end.  Otherwise,
+    * returns a null string.
+    */
+    static QString htmlBlockEnd(const QStringRef &line);
+
+    /*
+    * Returns true if the line, when following a blank line, starts a new
+    * top-level block rather than continuing a preceding list item,
+    * list or indented code block.
+    */
+    static bool startsTopLevelBlock(const QStringRef &line);
 };
 
-CmarkGfmAPI *CmarkGfmAPIPrivate::instance = nullptr;
-
 CmarkGfmAPI *CmarkGfmAPI::instance()
 {
-    if (nullptr == CmarkGfmAPIPrivate::instance) {
-        CmarkGfmAPIPrivate::instance = new CmarkGfmAPI();
-    }
+    // Note:  Initialization of function-local statics is thread-safe.
+    static CmarkGfmAPI api;
 
-    return CmarkGfmAPIPrivate::instance;
+    return &api;
 }
 
 CmarkGfmAPI::~CmarkGfmAPI()
@@ -68,7 +131,13 @@ CmarkGfmAPI::~CmarkGfmAPI()
     cmark_arena_reset();
 }
 
-MarkdownAST *CmarkGfmAPI::parse(const QString &text, const bool smartTypographyEnabled)
+MarkdownAST *CmarkGfmAPI::parse
+(
+    const QString &text,
+    const bool smartTypographyEnabled,
+    const int nodeCountHint,
+    const bool renderHtml
+)
 {
     Q_D(CmarkGfmAPI);
 
@@ -78,8 +147,9 @@ MarkdownAST *CmarkGfmAPI::parse(const QString &text, const bool smartTypographyE
         opts |= CMARK_OPT_SMART;
     }
 
-    d->apiMutex.lock();
-
+    // Note:  cmark-gfm's memory arena is thread-local, so each thread
+    // parses into (and resets) its own arena without blocking others.
+    //
     cmark_mem *mem = cmark_get_arena_mem_allocator();
     cmark_parser *parser = cmark_parser_new_with_mem(opts, mem);
 
@@ -89,19 +159,150 @@ MarkdownAST *CmarkGfmAPI::parse(const QString &text, const bool smartTypographyE
     cmark_parser_attach_syntax_extension(parser, d->tagfilterExt);
     cmark_parser_attach_syntax_extension(parser, d->tasklistExt);
 
-    // Use Latin1 instead of UTF-8 since the column numbers and even
-    // the nodes returned in the AST are shifted or missing when
-    // UTF-8 characters longer than 1 byte are encountered.
-    //
-    cmark_parser_feed(parser, text.toLatin1().data(), text.toLatin1().length());
+    QByteArray utf8 = text.toUtf8();
+    cmark_parser_feed(parser, utf8.constData(), utf8.length());
 
     cmark_node *root = cmark_parser_finish(parser);
-    MarkdownAST *ast = new MarkdownAST(root);
+
+    // cmark-gfm reports columns in bytes, which differ from the UTF-16
+    // positions in the text wherever it has multi-byte characters.
+    //
+    MarkdownAST *ast = new MarkdownAST(root, text, Utf8ColumnMap(text), nodeCountHint);
+
+    if (renderHtml) {
+        cmark_llist *extensions = cmark_parser_get_syntax_extensions(parser);
+        bool hasFootnotes = false;
+        QStringList blockHtml;
+
+        // Render each top-level block separately so that the HTML of
+        // blocks that aren't re-parsed can be reused.
+        //
+        for
+        (
+            cmark_node *block = cmark_node_first_child(root);
+            nullptr != block;
+            block = cmark_node_next(block)
+        ) {
+            if (CMARK_NODE_FOOTNOTE_DEFINITION == cmark_node_get_type(block)) {
+                hasFootnotes = true;
+                break;
+            }
+
+            blockHtml.append(QString::fromUtf8(cmark_render_html(block, opts, extensions)));
+        }
+
+        // Footnotes are numbered and gathered at the end of the document
+        // as it is rendered, so a document with footnotes is rendered as
+        // a whole.
+        //
+        if (hasFootnotes) {
+            ast->setHtml(QString::fromUtf8(cmark_render_html(root, opts, extensions)));
+        } else {
+            ast->setBlockHtml(blockHtml);
+        }
+    }
     cmark_parser_free(parser);
     cmark_node_free(root);
     cmark_arena_reset();
 
-    d->apiMutex.unlock();
+    return ast;
+}
+
+MarkdownAST *CmarkGfmAPI::parseInParallel
+(
+    const QString &text,
+    const bool smartTypographyEnabled,
+    const int nodeCountHint,
+    const bool renderHtml
+)
+{
+    Q_D(CmarkGfmAPI);
+
+    int chunkCount = QThread::idealThreadCount();
+    QVector<int> chunkStartLines;
+    QVector<int> chunkStarts;
+    QString definitions;
+    int definitionLineCount = 0;
+
+    if
+    (
+        (chunkCount < 2)
+        || !d->splitIntoChunks
+        (
+            text,
+            chunkCount,
+            chunkStartLines,
+            chunkStarts,
+            definitions,
+            definitionLineCount
+        )
+    ) {
+        return parse(text, smartTypographyEnabled, nodeCountHint, renderHtml);
+    }
+
+    chunkCount = chunkStarts.size();
+
+    // Each chunk is parsed into the arena of the pool thread that
+    // parses it.  The link reference definitions of the whole text are
+    // parsed ahead of each chunk, and the blocks parsed from any text
+    // that follows them on the same lines are skipped when joining the
+    // chunks' ASTs.
+    //
+    QVector<QFuture<MarkdownAST *>> futures;
+    QVector<int> firstLines;
+    QVector<int> lineOffsets;
+
+    for (int i = 0; i < chunkCount; i++) {
+        int end = (i < (chunkCount - 1)) ? chunkStarts[i + 1] : text.length();
+
+        futures.append
+        (
+            QtConcurrent::run
+            (
+                this,
+                &CmarkGfmAPI::parse,
+                definitions + text.mid(chunkStarts[i], end - chunkStarts[i]),
+                smartTypographyEnabled,
+                nodeCountHint / chunkCount,
+                renderHtml
+            )
+        );
+
+        firstLines.append(definitionLineCount + 1);
+        lineOffsets.append(chunkStartLines[i] - 1 - definitionLineCount);
+    }
+
+    QVector<MarkdownAST *> chunks;
+
+    for (int i = 0; i < chunkCount; i++) {
+        chunks.append(futures[i].result());
+    }
+
+    MarkdownAST *ast = MarkdownAST::join(chunks, firstLines, lineOffsets, text);
+
+    qDeleteAll(chunks);
+
+    // A fenced code block or HTML block left open at the end of a chunk
+    // means that the chunk after it was split from the middle of that
+    // block, such as when HTML hides what looks like a fence, so parse
+    // the text as a whole instead.
+    //
+    for (int i = 1; i < chunkCount; i++) {
+        MarkdownNode *node = ast->findBlockAtLine(chunkStartLines[i] - 1);
+
+        while (nullptr != node) {
+            if
+            (
+                (MarkdownNode::HtmlBlock == node->type())
+                || node->isFencedCodeBlock()
+            ) {
+                delete ast;
+                return parse(text, smartTypographyEnabled, nodeCountHint, renderHtml);
+            }
+
+            node = node->parent();
+        }
+    }
 
     return ast;
 }
@@ -116,8 +317,6 @@ QString CmarkGfmAPI::renderToHtml(const QString &text, const bool smartTypograph
         opts |= CMARK_OPT_SMART;
     }
 
-    d->apiMutex.lock();
-
     cmark_mem *mem = cmark_get_arena_mem_allocator();
     cmark_parser *parser = cmark_parser_new_with_mem(opts, mem);
 
@@ -127,7 +326,8 @@ QString CmarkGfmAPI::renderToHtml(const QString &text, const bool smartTypograph
     cmark_parser_attach_syntax_extension(parser, d->tagfilterExt);
     cmark_parser_attach_syntax_extension(parser, d->tasklistExt);
 
-    cmark_parser_feed(parser, text.toUtf8().data(), text.toUtf8().length());
+    QByteArray utf8 = text.toUtf8();
+    cmark_parser_feed(parser, utf8.constData(), utf8.length());
 
     cmark_node *root = cmark_parser_finish(parser);
     char *output = cmark_render_html(root, opts, cmark_parser_get_syntax_extensions(parser));
@@ -136,8 +336,6 @@ QString CmarkGfmAPI::renderToHtml(const QString &text, const bool smartTypograph
     cmark_parser_free(parser);
     cmark_arena_reset();
 
-    d->apiMutex.unlock();
-
     return html;
 }
 
@@ -152,5 +350,316 @@ CmarkGfmAPI::CmarkGfmAPI()
     d->autolinkExt = cmark_find_syntax_extension("autolink");
     d->tagfilterExt = cmark_find_syntax_extension("tagfilter");
     d->tasklistExt = cmark_find_syntax_extension("tasklist");
+
+    d->referenceDefinitionRegex.setPattern("^ {0,3}\\[[^\\]]+\\]:");
+
+    // Definitions nested in block quotes, lists or indented text.
+    d->nestedDefinitionRegex.setPattern
+    (
+        "^(?:[ \\t]*(?:>|[-+*][ \\t]|\\d{1,9}[.)][ \\t])|\\t| {4})[ \\t>]*\\[[^\\]]+\\]:"
+    );
+    d->nestedDefinitionRegex.setPatternOptions(QRegularExpression::MultilineOption);
+    d->footnoteDefinitionRegex.setPattern("^[ \\t>]*\\[\\^[^\\]]+\\]:");
+    d->footnoteDefinitionRegex.setPatternOptions(QRegularExpression::MultilineOption);
+}
+
+bool CmarkGfmAPIPrivate::splitIntoChunks
+(
+    const QString &text,
+    int chunkCount,
+    QVector<int> &chunkStartLines,
+    QVector<int> &chunkStarts,
+    QString &definitions,
+    int &definitionLineCount
+) const
+{
+    // Footnotes are numbered across the whole document, and definitions
+    // nested in other blocks are not gathered below, so parse texts with
+    // either as a whole.
+    //
+    if (text.contains(footnoteDefinitionRegex) || text.contains(nestedDefinitionRegex)) {
+        return false;
+    }
+
+    // Lines end at a line feed, carriage return, or both, as they do
+    // for cmark-gfm.
+    //
+    QVector<int> lineStarts;
+    QVector<int> lineLengths;
+    int start = 0;
+
+    for (int i = 0; i < text.length(); i++) {
+        QChar c = text[i];
+
+        if (('\n' == c) || ('\r' == c)) {
+            lineStarts.append(start);
+            lineLengths.append(i - start);
+
+            if (('\r' == c) && ((i + 1) < text.length()) && ('\n' == text[i + 1])) {
+                i++;
+            }
+
+            start = i + 1;
+        }
+    }
+
+    if (start < text.length()) {
+        lineStarts.append(start);
+        lineLengths.append(text.length() - start);
+    }
+
+    int lineCount = lineStarts.size();
+
+    if (lineCount < MinParallelParseLines) {
+        return false;
+    }
+
+    chunkCount = qMin(chunkCount, lineCount / MinChunkLines);
+
+    if (chunkCount < 2) {
+        return false;
+    }
+
+    chunkStartLines.clear();
+    chunkStarts.clear();
+    chunkStartLines.append(1);
+    chunkStarts.append(0);
+
+    QStringList definitionLines;
+    QChar fenceChar;
+    int fenceLength = 0;
+    QString htmlEnd;
+    bool previousBlank = true;
+    bool inDefinition = false;
+
+    for (int i = 0; i < lineCount; i++) {
+        QStringRef line = text.midRef(lineStarts[i], lineLengths[i]);
+        bool blank = line.trimmed().isEmpty();
+
+        if (fenceLength > 0) {
+            if (closesFence(line, fenceChar, fenceLength)) {
+                fenceLength = 0;
+            }
+        } else if (!htmlEnd.isNull()) {
+            if (line.contains(htmlEnd, Qt::CaseInsensitive)) {
+                htmlEnd = QString();
+            }
+        } else {
+            int nextChunk = chunkStarts.size();
+
+            if
+            (
+                previousBlank
+                && !blank
+                && (nextChunk < chunkCount)
+                && (i >= ((qint64) nextChunk * lineCount / chunkCount))
+                && startsTopLevelBlock(line)
+            ) {
+                chunkStartLines.append(i + 1);
+                chunkStarts.append(lineStarts[i]);
+            }
+
+            if (blank) {
+                if (inDefinition) {
+                    definitionLines.append(QString());
+                    inDefinition = false;
+                }
+            } else if (inDefinition) {
+                definitionLines.append(line.toString());
+            } else if (referenceDefinitionRegex.match(line).hasMatch()) {
+                // A definition cannot interrupt a paragraph, so leave
+                // telling whether it is one to the parser.
+                //
+                if (!previousBlank) {
+                    return false;
+                }
+
+                definitionLines.append(line.toString());
+                inDefinition = true;
+            }
+
+            if (!opensFence(line, fenceChar, fenceLength)) {
+                htmlEnd = htmlBlockEnd(line);
+
+                if (!htmlEnd.isNull() && line.contains(htmlEnd, Qt::CaseInsensitive)) {
+                    htmlEnd = QString();
+                }
+            }
+
+            // Text following a definition that opens a block which
+            // a blank line doesn't close would run into the chunk.
+            //
+            if (inDefinition && ((fenceLength > 0) || !htmlEnd.isNull())) {
+                return false;
+            }
+        }
+
+        previousBlank = blank;
+    }
+
+    if (chunkStarts.size() < 2) {
+        return false;
+    }
+
+    if (inDefinition) {
+        definitionLines.append(QString());
+    }
+
+    definitionLineCount = definitionLines.size();
+    definitions = QString();
+
+    if (definitionLineCount > 0) {
+        definitions = definitionLines.join('\n') + '\n';
+    }
+
+    return true;
+}
+
+int CmarkGfmAPIPrivate::indentation(const QStringRef &line, int &index)
+{
+    int columns = 0;
+
+    for (index = 0; index < line.length(); index++) {
+        if (' ' == line.at(index)) {
+            columns++;
+        } else if ('\t' == line.at(index)) {
+            columns += 4 - (columns % 4);
+        } else {
+            break;
+        }
+    }
+
+    return columns;
+}
+
+bool CmarkGfmAPIPrivate::opensFence
+(
+    const QStringRef &line,
+    QChar &fenceChar,
+    int &fenceLength
+)
+{
+    int index;
+
+    if ((indentation(line, index) > 3) || (index >= line.length())) {
+        return false;
+    }
+
+    QChar c = line.at(index);
+
+    if (('`' != c) && ('~' != c)) {
+        return false;
+    }
+
+    int length = 0;
+
+    while (((index + length) < line.length()) && (c == line.at(index + length))) {
+        length++;
+    }
+
+    // The info string of a backtick fence can't contain a backtick,
+    // or else the line is inline code.
+    //
+    if ((length < 3) || (('`' == c) && line.mid(index + length).contains('`'))) {
+        return false;
+    }
+
+    fenceChar = c;
+    fenceLength = length;
+    return true;
+}
+
+bool CmarkGfmAPIPrivate::closesFence
+(
+    const QStringRef &line,
+    QChar fenceChar,
+    int fenceLength
+)
+{
+    int index;
+
+    if (indentation(line, index) > 3) {
+        return false;
+    }
+
+    int length = 0;
+
+    while (((index + length) < line.length()) && (fenceChar == line.at(index + length))) {
+        length++;
+    }
+
+    return (length >= fenceLength) && line.mid(index + length).trimmed().isEmpty();
+}
+
+QString CmarkGfmAPIPrivate::htmlBlockEnd(const QStringRef &line)
+{
+    int index;
+
+    if ((indentation(line, index) > 3) || (index >= line.length()) || ('<' != line.at(index))) {
+        return QString();
+    }
+
+    QStringRef tag = line.mid(index);
+
+    if (tag.startsWith("<!--")) {
+        return "-->";
+    } else if (tag.startsWith("<?")) {
+        return "?>";
+    } else if (tag.startsWith("<![CDATA[")) {
+        return "]]>";
+    } else if ((tag.length() > 2) && ('!' == tag.at(1)) && (tag.at(2).toLatin1() >= 'A') && (tag.at(2).toLatin1() <= 'Z')) {
+        return ">";
+    }
+
+    static const char *rawTags[] = { "script", "pre", "style", "textarea" };
+
+    for (const char *rawTag : rawTags) {
+        QString name(rawTag);
+
+        if
+        (
+            tag.mid(1).startsWith(name, Qt::CaseInsensitive)
+            &&
+            (
+                (tag.length() == (name.length() + 1))
+                || tag.at(name.length() + 1).isSpace()
+                || ('>' == tag.at(name.length() + 1))
+            )
+        ) {
+            return "</" + name + ">";
+        }
+    }
+
+    return QString();
+}
+
+bool CmarkGfmAPIPrivate::startsTopLevelBlock(const QStringRef &line)
+{
+    if (line.isEmpty() || (' ' == line.at(0)) || ('\t' == line.at(0))) {
+        return false;
+    }
+
+    // A list item would join a list that precedes the blank line.
+    QChar c = line.at(0);
+
+    if (('-' == c) || ('+' == c) || ('*' == c)) {
+        return (line.length() > 1) && !line.at(1).isSpace();
+    }
+
+    int digits = 0;
+
+    while ((digits < line.length()) && line.at(digits).isDigit()) {
+        digits++;
+    }
+
+    if ((digits > 0) && (digits <= 9) && (digits < line.length())) {
+        QChar delimiter = line.at(digits);
+
+        if (('.' == delimiter) || (')' == delimiter)) {
+            return ((digits + 1) < line.length()) && !line.at(digits + 1).isSpace();
+        }
+    }
+
+    return true;
 }
 }
@@ -27,7 +27,8 @@
 namespace ghostwriter
 {
 /**
- * This class wraps the cmark-gfm API to make it thread-safe.
+ * This class wraps the cmark-gfm API to make it thread-safe.  Documents
+ * may be parsed and rendered on several threads at once.
  */
 class CmarkGfmAPIPrivate;
 class CmarkGfmAPI
@@ -48,9 +49,35 @@ public:
     /**
      * Parses the given Markdown text, returning an AST representation.
      * of the text.  Pass in true for smartTypographyEnabled to enable
-     * smart typography.
+     * smart typography.  The node count hint, if greater than zero, is
+     * the expected number of nodes in the AST, such as the node count
+     * of the AST for a prior version of the text.  Pass in true for
+     * renderHtml to also render HTML from the parsed text into the AST,
+     * which saves parsing the text again to render it.
      */
-    MarkdownAST *parse(const QString &text, const bool smartTypographyEnabled);
+    MarkdownAST *parse
+    (
+        const QString &text,
+        const bool smartTypographyEnabled,
+        const int nodeCountHint = 0,
+        const bool renderHtml = false
+    );
+
+    /**
+     * Parses the given Markdown text the same as parse(), except that
+     * long texts are split into chunks at blank lines across which no
+     * block can continue, and the chunks are parsed on the global thread
+     * pool.  Link reference definitions apply across chunks.  Texts with
+     * footnotes, or that can't be split safely, are parsed on the calling
+     * thread.  Do not call this method from a thread of the global pool.
+     */
+    MarkdownAST *parseInParallel
+    (
+        const QString &text,
+        const bool smartTypographyEnabled,
+        const int nodeCountHint = 0,
+        const bool renderHtml = false
+    );
 
     /**
      * Returns HTML text for the Markdown text.  Pass in true for
@@ -18,12 +18,32 @@
  ***********************************************************************/
 
 #include <QtCore/qmath.h>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPointer>
 #include <QTextBoundaryFinder>
+#include <QTimer>
+#include <QtConcurrentRun>
+#include <QVector>
 
 #include "documentstatistics.h"
+#include "wordtokenizer.h"
 
 namespace ghostwriter
 {
+/*
+ * Sentence count of the text of a block, as counted on a background
+ * thread.  The revision is that of the block's metadata when its text
+ * was taken, so that the count is only kept if the text is unchanged.
+ */
+typedef struct BlockSentenceCount
+{
+    int id;
+    quint64 revision;
+    QString text;
+    int sentenceCount;
+} BlockSentenceCount;
+
 class DocumentStatisticsPrivate
 {
     Q_DECLARE_PUBLIC(DocumentStatistics)
@@ -31,7 +51,7 @@ class DocumentStatisticsPrivate
 public:
 
     DocumentStatisticsPrivate(DocumentStatistics *q_ptr)
-        : q_ptr(q_ptr)
+        : q_ptr(q_ptr), totals(blocks.totals)
     {
         ;
     }
@@ -49,30 +69,45 @@ public:
     static const QString VERY_DIFFICULT_READING_EASE_STR;
 
     DocumentStatistics *q_ptr;
-    MarkdownDocument *document;
+    QPointer<MarkdownDocument> document;
 
-    int wordCount; // may be count of selected text only or entire document
-    int totalWordCount; // word count of entire document
-
-    // Count of characters that are "word" characters.
-    int wordCharacterCount;
+    // Metadata of the document's blocks along with the running totals of
+    // their statistics, which blocks remove their own statistics from
+    // when they are deleted.
+    //
+    TextBlockMetadataTable blocks;
+    TextBlockStatistics &totals;
 
-    int sentenceCount;
-    int paragraphCount;
+    int totalWordCount; // word count of entire document last published
     int pageCount;
-    int lixLongWordCount;
     int readTimeMinutes;
 
-    void updateStatistics();
+    bool textSelected;
+    int selectionStart;
+    int selectionEnd;
+
+    // Sentences are counted in the background once blocks change, while
+    // the other statistics are counted as soon as the blocks change.
+    // The text of blocks whose sentences are to be counted is kept by the
+    // id of their metadata until then.
+    //
+    quint64 lastRevision;
+    QHash<int, QString> outdatedSentences;
+    QFutureWatcher<QVector<BlockSentenceCount>> *sentenceCounter;
+
+    // Coalesces changes into at most MaxUpdatesPerSecond updates.
+    QTimer *updateTimer;
+
+    void resetTotals();
+    void scheduleUpdate();
+    void onUpdateTimerExpired();
+    void onSentencesCounted();
+    void publishStatistics();
     void updateBlockStatistics(QTextBlock &block);
-    void countWords
-    (
-        const QString &text,
-        int &words,
-        int &lixLongWords,
-        int &alphaNumericCharacters
-    );
-    int countSentences(const QString &text);
+    void countSelection(TextBlockStatistics &selection);
+    static void countStatistics(const QString &text, TextBlockStatistics &statistics);
+    static int countSentences(const QString &text);
+    static QVector<BlockSentenceCount> countBlockSentences(QVector<BlockSentenceCount> counts);
     int calculatePageCount(int words);
     int calculateCLI(int characters, int words, int sentences);
     int calculateLIX(int totalWords, int longWords, int sentences);
@@ -86,40 +121,78 @@ DocumentStatistics::DocumentStatistics(MarkdownDocument *document, QObject *pare
     Q_D(DocumentStatistics);
 
     d->document = document;
-    d->wordCount = 0;
     d->totalWordCount = 0;
-    d->wordCharacterCount = 0;
-    d->sentenceCount = 0;
-    d->paragraphCount = 0;
-    d->pageCount = 0;
-    d->lixLongWordCount = 0;
-    d->readTimeMinutes = 0;
+    d->textSelected = false;
+    d->selectionStart = 0;
+    d->selectionEnd = 0;
+    d->lastRevision = 0;
+    d->resetTotals();
+
+    d->updateTimer = new QTimer(this);
+    d->updateTimer->setSingleShot(true);
+    d->updateTimer->setInterval(1000 / MaxUpdatesPerSecond);
+
+    this->connect
+    (
+        d->updateTimer,
+        &QTimer::timeout,
+        [d]() {
+            d->onUpdateTimerExpired();
+        }
+    );
+
+    d->sentenceCounter = new QFutureWatcher<QVector<BlockSentenceCount>>(this);
+
+    this->connect
+    (
+        d->sentenceCounter,
+        &QFutureWatcher<QVector<BlockSentenceCount>>::finished,
+        [d]() {
+            d->onSentencesCounted();
+        }
+    );
+
+    // Count any text the document already has.  From here on, only the
+    // blocks that change are counted again.
+    //
+    for (QTextBlock block = d->document->begin(); block.isValid(); block = block.next()) {
+        d->updateBlockStatistics(block);
+    }
+
+    d->scheduleUpdate();
 
     connect(d->document, SIGNAL(contentsChange(int, int, int)), this, SLOT(onTextChanged(int, int, int)));
     connect(d->document,
         &MarkdownDocument::cleared,
         [d]() {
-            d->wordCount = 0;
-            d->wordCharacterCount = 0;
-            d->sentenceCount = 0;
-            d->paragraphCount = 0;
-            d->pageCount = 0;
-            d->lixLongWordCount = 0;
-            d->readTimeMinutes = 0;
-            d->updateStatistics();
+            d->resetTotals();
+            d->scheduleUpdate();
         });
 }
 
 DocumentStatistics::~DocumentStatistics()
 {
-    ;
+    Q_D(DocumentStatistics);
+
+    d->sentenceCounter->waitForFinished();
+
+    // Keep blocks that outlive the statistics from updating the totals.
+    if (!d->document.isNull()) {
+        for (QTextBlock block = d->document->begin(); block.isValid(); block = block.next()) {
+            TextBlockData *blockData = (TextBlockData *) block.userData();
+
+            if (nullptr != blockData) {
+                blockData->table = nullptr;
+            }
+        }
+    }
 }
 
 int DocumentStatistics::wordCount() const
 {
     Q_D(const DocumentStatistics);
     
-    return d->wordCount;
+    return d->totals.wordCount;
 }
 
 int DocumentStatistics::characterCount() const
@@ -133,14 +206,14 @@ int DocumentStatistics::paragraphCount() const
 {
     Q_D(const DocumentStatistics);
 
-    return d->paragraphCount;
+    return d->totals.paragraphCount;
 }
 
 int DocumentStatistics::sentenceCount() const
 {
     Q_D(const DocumentStatistics);
 
-    return d->sentenceCount;
+    return d->totals.sentenceCount;
 }
 
 int DocumentStatistics::pageCount() const
@@ -157,221 +230,302 @@ int DocumentStatistics::readingTime() const
     return d->readTimeMinutes;
 }
 
-void DocumentStatistics::onTextSelected
-(
-    const QString &selectedText,
-    int selectionStart,
-    int selectionEnd
-)
+void DocumentStatistics::onTextSelected(int selectionStart, int selectionEnd)
+{
+    Q_D(DocumentStatistics);
+
+    d->textSelected = true;
+    d->selectionStart = selectionStart;
+    d->selectionEnd = selectionEnd;
+    d->scheduleUpdate();
+}
+
+void DocumentStatistics::onTextDeselected()
 {
     Q_D(DocumentStatistics);
     
-    int selectionWordCount;
-    int selectionLixLongWordCount;
-    int selectionWordCharacterCount;
+    d->textSelected = false;
+    d->scheduleUpdate();
+}
 
-    d->countWords
-    (
-        selectedText,
-        selectionWordCount,
-        selectionLixLongWordCount,
-        selectionWordCharacterCount
-    );
+void DocumentStatistics::onTextChanged(int position, int charsRemoved, int charsAdded)
+{
+    Q_D(DocumentStatistics);
 
-    int selectionSentenceCount = d->countSentences(selectedText);
+    Q_UNUSED(charsRemoved)
 
-    // Count the number of selected paragraphs.
-    int selectedParagraphCount = 0;
+    // Update the statistics of affected blocks only.  Removed text is
+    // merged into the block at the change's position, and blocks that
+    // were removed entirely have already taken their statistics out of
+    // the totals upon deletion of their TextBlockData.
+    //
+    int lastPosition = qMin(position + charsAdded, d->document->characterCount() - 1);
+    QTextBlock block = d->document->findBlock(position);
+    QTextBlock endBlock = d->document->findBlock(lastPosition);
 
-    QTextBlock block = d->document->findBlock(selectionStart);
-    QTextBlock end = d->document->findBlock(selectionEnd).next();
+    if (!block.isValid()) {
+        block = d->document->lastBlock();
+    }
 
-    while (block != end) {
-        TextBlockData *blockData = (TextBlockData *) block.userData();
+    if (!endBlock.isValid()) {
+        endBlock = d->document->lastBlock();
+    }
 
-        if ((nullptr != blockData) && (block.text().trimmed().length() > 0)) {
-            selectedParagraphCount++;
-        }
+    d->updateBlockStatistics(block);
 
+    while (block.isValid() && (block != endBlock)) {
         block = block.next();
+        d->updateBlockStatistics(block);
     }
 
-    emit wordCountChanged(selectionWordCount);
-    emit characterCountChanged(selectedText.length());
-    emit sentenceCountChanged(selectionSentenceCount);
-    emit paragraphCountChanged(selectedParagraphCount);
-    emit pageCountChanged(d->calculatePageCount(selectionWordCount));
-    emit complexWordsChanged(d->calculateComplexWords(selectionWordCount, selectionLixLongWordCount));
-    emit readingTimeChanged(d->calculateReadingTime(selectionWordCount));
-    emit lixReadingEaseChanged(d->calculateLIX(selectionWordCount, selectionLixLongWordCount, selectionSentenceCount));
-    emit readabilityIndexChanged(d->calculateCLI(selectionWordCharacterCount, selectionWordCount, selectionSentenceCount));
+    d->scheduleUpdate();
 }
 
-void DocumentStatistics::onTextDeselected()
+void DocumentStatisticsPrivate::resetTotals()
 {
-    Q_D(DocumentStatistics);
-    
-    d->updateStatistics();
+    blocks.clearTotals();
+    pageCount = 0;
+    readTimeMinutes = 0;
 }
 
-void DocumentStatistics::onTextChanged(int position, int charsRemoved, int charsAdded)
+void DocumentStatisticsPrivate::scheduleUpdate()
 {
-    Q_D(DocumentStatistics);
+    if (!updateTimer->isActive()) {
+        updateTimer->start();
+    }
+}
 
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
+void DocumentStatisticsPrivate::onUpdateTimerExpired()
+{
+    // Statistics are published once the sentences being counted are done.
+    if (sentenceCounter->isRunning()) {
+        return;
+    }
 
-    d->wordCount = 0;
-    d->wordCharacterCount = 0;
-    d->sentenceCount = 0;
-    d->paragraphCount = 0;
-    d->pageCount = 0;
-    d->lixLongWordCount = 0;
-    d->readTimeMinutes = 0;
+    if (!outdatedSentences.isEmpty()) {
+        QVector<BlockSentenceCount> counts;
 
-    // Update the word counts of affected blocks.
-    //
-    QTextBlock startBlock = d->document->firstBlock();
-    QTextBlock endBlock = d->document->lastBlock();
-    QTextBlock block = startBlock;
+        counts.reserve(outdatedSentences.size());
 
-    d->updateBlockStatistics(block);
+        // Skip the text of blocks that have since been removed.
+        QHash<int, QString>::const_iterator it;
 
-    while (block != endBlock) {
-        block = block.next();
-        d->updateBlockStatistics(block);
+        for (it = outdatedSentences.constBegin(); it != outdatedSentences.constEnd(); ++it) {
+            quint64 revision = blocks[it.key()].revision;
+
+            if (0 != revision) {
+                counts.append({ it.key(), revision, it.value(), 0 });
+            }
+        }
+
+        outdatedSentences.clear();
+
+        if (!counts.isEmpty()) {
+            sentenceCounter->setFuture
+            (
+                QtConcurrent::run
+                (
+                    &DocumentStatisticsPrivate::countBlockSentences,
+                    counts
+                )
+            );
+            return;
+        }
     }
 
-    d->updateStatistics();
+    publishStatistics();
 }
 
-void DocumentStatisticsPrivate::updateStatistics()
+void DocumentStatisticsPrivate::onSentencesCounted()
+{
+    QVector<BlockSentenceCount> results = sentenceCounter->result();
+
+    // Only apply counts to blocks that still exist and whose text has not
+    // changed since being counted.  Revisions are never reused, so the
+    // metadata of removed blocks, or of new blocks reusing their ids,
+    // does not match.
+    //
+    foreach (const BlockSentenceCount &result, results) {
+        TextBlockMetadata &metadata = blocks[result.id];
+
+        if (result.revision == metadata.revision) {
+            totals.sentenceCount += result.sentenceCount - metadata.statistics.sentenceCount;
+            metadata.statistics.sentenceCount = result.sentenceCount;
+            metadata.sentenceRevision = metadata.revision;
+        }
+    }
+
+    publishStatistics();
+
+    if (!outdatedSentences.isEmpty()) {
+        scheduleUpdate();
+    }
+}
+
+void DocumentStatisticsPrivate::publishStatistics()
 {
     Q_Q(DocumentStatistics);
 
-    this->pageCount = calculatePageCount(wordCount);
-    this->readTimeMinutes = calculateReadingTime(wordCount);
-    
-    emit q->wordCountChanged(wordCount);
-    emit q->totalWordCountChanged(wordCount);
-    emit q->characterCountChanged(document->characterCount() - 1);
-    emit q->sentenceCountChanged(sentenceCount);
-    emit q->paragraphCountChanged(paragraphCount);
-    emit q->pageCountChanged(pageCount);
-    emit q->complexWordsChanged(calculateComplexWords(wordCount, lixLongWordCount));
-    emit q->readingTimeChanged(this->readTimeMinutes);
-    emit q->lixReadingEaseChanged(calculateLIX(wordCount, lixLongWordCount, sentenceCount));
-    emit q->readabilityIndexChanged(calculateCLI(wordCharacterCount, wordCount, sentenceCount));
+    TextBlockStatistics counts = totals;
+    int characterCount = document->characterCount() - 1;
+
+    this->pageCount = calculatePageCount(totals.wordCount);
+    this->readTimeMinutes = calculateReadingTime(totals.wordCount);
+
+    if (textSelected) {
+        countSelection(counts);
+        characterCount = qMin(selectionEnd, characterCount) - selectionStart;
+    }
+
+    DocumentStatisticsData statistics;
+
+    statistics.wordCount = counts.wordCount;
+    statistics.totalWordCount = totals.wordCount;
+    statistics.characterCount = characterCount;
+    statistics.sentenceCount = counts.sentenceCount;
+    statistics.paragraphCount = counts.paragraphCount;
+    statistics.pageCount = calculatePageCount(counts.wordCount);
+    statistics.complexWords = calculateComplexWords(counts.wordCount, counts.lixLongWordCount);
+    statistics.readingTime = calculateReadingTime(counts.wordCount);
+    statistics.lixReadingEase = calculateLIX(counts.wordCount, counts.lixLongWordCount, counts.sentenceCount);
+    statistics.readabilityIndex = calculateCLI(counts.alphaNumericCharacterCount, counts.wordCount, counts.sentenceCount);
+
+    emit q->statisticsChanged(statistics);
+
+    if (totals.wordCount != totalWordCount) {
+        totalWordCount = totals.wordCount;
+        emit q->totalWordCountChanged(totalWordCount);
+    }
 }
 
 void DocumentStatisticsPrivate::updateBlockStatistics(QTextBlock &block)
 {
+    if (!block.isValid()) {
+        return;
+    }
+
     TextBlockData *blockData = (TextBlockData *) block.userData();
+    QString text = block.text();
+    uint textHash = qHash(text);
 
     if (nullptr == blockData) {
-        blockData = new TextBlockData(document, block);
+        blockData = new TextBlockData(&blocks);
         block.setUserData(blockData);
+    } else if (textHash == blocks[blockData->id].textHash) {
+        // Only the block's formatting changed, such as by the highlighter.
+        return;
     }
 
-    countWords
+    TextBlockMetadata &metadata = blocks[blockData->id];
+    TextBlockStatistics &statistics = metadata.statistics;
+
+    totals.wordCount -= statistics.wordCount;
+    totals.lixLongWordCount -= statistics.lixLongWordCount;
+    totals.alphaNumericCharacterCount -= statistics.alphaNumericCharacterCount;
+    totals.paragraphCount -= statistics.paragraphCount;
+
+    WordTokenizer::countWords
     (
-        block.text(),
-        blockData->wordCount,
-        blockData->lixLongWordCount,
-        blockData->alphaNumericCharacterCount
+        text,
+        statistics.wordCount,
+        statistics.lixLongWordCount,
+        statistics.alphaNumericCharacterCount
     );
 
-    wordCount += blockData->wordCount;
-    lixLongWordCount += blockData->lixLongWordCount;
-    wordCharacterCount += blockData->alphaNumericCharacterCount;
+    statistics.paragraphCount = (text.trimmed().length() > 0) ? 1 : 0;
 
-    blockData->sentenceCount = countSentences(block.text());
-    sentenceCount += blockData->sentenceCount;
+    totals.wordCount += statistics.wordCount;
+    totals.lixLongWordCount += statistics.lixLongWordCount;
+    totals.alphaNumericCharacterCount += statistics.alphaNumericCharacterCount;
+    totals.paragraphCount += statistics.paragraphCount;
 
-    if (block.text().trimmed().length() > 0) {
-        paragraphCount++;
-    }
+    // The block's old sentence count stays in the totals until its
+    // sentences are counted again in the background.
+    //
+    metadata.textHash = textHash;
+    metadata.revision = ++lastRevision;
+    outdatedSentences.insert(blockData->id, text);
 }
 
-void DocumentStatisticsPrivate::countWords
-(
-    const QString &text,
-    int &words,
-    int &lixLongWords,
-    int &alphaNumericCharacters
-)
+void DocumentStatisticsPrivate::countSelection(TextBlockStatistics &selection)
 {
-    bool inWord = false;
-    int separatorCount = 0;
-    int wordLen = 0;
-
-    words = 0;
-    lixLongWords = 0;
-    alphaNumericCharacters = 0;
-
-    for (int i = 0; i < text.length(); i++) {
-        if (text[i].isLetterOrNumber()) {
-            inWord = true;
-            separatorCount = 0;
-            wordLen++;
-            alphaNumericCharacters++;
-        } else if (text[i].isSpace() && inWord) {
-            inWord = false;
-            words++;
-
-            if (separatorCount > 0) {
-                wordLen--;
-                alphaNumericCharacters--;
-            }
+    int end = qMin(selectionEnd, document->characterCount() - 1);
 
-            separatorCount = 0;
+    selection.wordCount = 0;
+    selection.alphaNumericCharacterCount = 0;
+    selection.sentenceCount = 0;
+    selection.lixLongWordCount = 0;
+    selection.paragraphCount = 0;
 
-            if (wordLen > 6) {
-                lixLongWords++;
-            }
+    // Sum the cached statistics of the blocks that are entirely selected,
+    // and only count the selected text of partially selected blocks.
+    // Paragraphs are counted if any part of them is selected.
+    //
+    QTextBlock block = document->findBlock(selectionStart);
+    QTextBlock endBlock = document->findBlock(end).next();
 
-            wordLen = 0;
-        } else {
-            // This is to handle things like double dashes (`--`)
-            // that separate words, while still counting hyphenated
-            // words as a single word.
-            //
-            separatorCount++;
-
-            if (inWord) {
-                if (separatorCount > 1) {
-                    separatorCount = 0;
-                    inWord = false;
-                    words++;
-                    wordLen--;
-                    alphaNumericCharacters--;
-
-                    if (wordLen > 6) {
-                        lixLongWords++;
-                    }
-
-                    wordLen = 0;
-                } else {
-                    wordLen++;
-                    alphaNumericCharacters++;
-                }
+    while (block.isValid() && (block != endBlock)) {
+        TextBlockData *blockData = (TextBlockData *) block.userData();
+        int blockStart = block.position();
+        int blockEnd = blockStart + block.length() - 1;
+
+        if (nullptr == blockData) {
+            updateBlockStatistics(block);
+            blockData = (TextBlockData *) block.userData();
+        }
+
+        const TextBlockMetadata &metadata = blocks[blockData->id];
+
+        if ((selectionStart <= blockStart) && (end >= blockEnd)) {
+            selection.wordCount += metadata.statistics.wordCount;
+            selection.alphaNumericCharacterCount += metadata.statistics.alphaNumericCharacterCount;
+            selection.lixLongWordCount += metadata.statistics.lixLongWordCount;
+
+            if (metadata.revision == metadata.sentenceRevision) {
+                selection.sentenceCount += metadata.statistics.sentenceCount;
+            } else {
+                selection.sentenceCount += countSentences(block.text());
             }
+        } else {
+            int from = qMax(selectionStart, blockStart) - blockStart;
+            int to = qMin(end, blockEnd) - blockStart;
+
+            countStatistics(block.text().mid(from, to - from), selection);
         }
+
+        selection.paragraphCount += metadata.statistics.paragraphCount;
+        block = block.next();
     }
+}
+
+void DocumentStatisticsPrivate::countStatistics
+(
+    const QString &text,
+    TextBlockStatistics &statistics
+)
+{
+    int words;
+    int longWords;
+    int wordCharacters;
 
-    if (inWord) {
-        words++;
+    WordTokenizer::countWords(text, words, longWords, wordCharacters);
 
-        if (separatorCount > 0) {
-            wordLen--;
-            alphaNumericCharacters--;
-        }
+    statistics.wordCount += words;
+    statistics.lixLongWordCount += longWords;
+    statistics.alphaNumericCharacterCount += wordCharacters;
+    statistics.sentenceCount += countSentences(text);
+}
 
-        if (wordLen > 6) {
-            lixLongWords++;
-        }
+QVector<BlockSentenceCount> DocumentStatisticsPrivate::countBlockSentences
+(
+    QVector<BlockSentenceCount> counts
+)
+{
+    for (int i = 0; i < counts.size(); i++) {
+        counts[i].sentenceCount = countSentences(counts[i].text);
     }
+
+    return counts;
 }
 
 int DocumentStatisticsPrivate::countSentences(const QString &text)
@@ -28,8 +28,29 @@
 
 namespace ghostwriter
 {
+/**
+ * Statistics of a document, or of the text selected in it.
+ */
+typedef struct DocumentStatisticsData
+{
+    int wordCount; // may be count of selected text only or entire document
+    int totalWordCount; // word count of entire document
+    int characterCount;
+    int sentenceCount;
+    int paragraphCount;
+    int pageCount;
+    int complexWords; // percentage of words
+    int readingTime; // minutes
+    int lixReadingEase;
+    int readabilityIndex; // Coleman-Liau readability index (CLI)
+} DocumentStatisticsData;
+
 /**
  * Class to compute document statistics for a QTextDocument.
+ *
+ * Sentences are counted on a background thread, and the statistics are
+ * published at most MaxUpdatesPerSecond times per second as a single
+ * DocumentStatisticsData.
  */
 class DocumentStatisticsPrivate;
 class DocumentStatistics : public QObject
@@ -63,12 +84,18 @@ public:
 
     int readingTime() const;
 
+    /**
+     * Maximum number of times per second that statisticsChanged()
+     * is emitted.
+     */
+    static const int MaxUpdatesPerSecond = 4;
+
 signals:
     /**
-     * Emitted when word count changes.  May be word count
-     * of entire document or of selected text.
+     * Emitted when the statistics change.  They may be those of the
+     * entire document or of the selected text.
      */
-    void wordCountChanged(int value);
+    void statisticsChanged(const DocumentStatisticsData &statistics);
 
     /**
      * Emitted when word count changes.  The value is
@@ -76,56 +103,12 @@ signals:
      */
     void totalWordCountChanged(int value);
 
-    /**
-     * Emitted when character count changes.
-     */
-    void characterCountChanged(int value);
-
-    /**
-     * Emitted when paragraph count changes.
-     */
-    void paragraphCountChanged(int value);
-
-    /**
-     * Emitted when sentence count changes.
-     */
-    void sentenceCountChanged(int value);
-
-    /**
-     * Emitted when page count changes.
-     */
-    void pageCountChanged(int value);
-
-    /**
-     * Emitted when complex word percentage changes.
-     */
-    void complexWordsChanged(int percentage);
-
-    /**
-     * Emitted when reading time changes.
-     */
-    void readingTimeChanged(int minutes);
-
-    /**
-     * Emitted when LIX reading ease value changes.
-     */
-    void lixReadingEaseChanged(int value);
-
-    /**
-     * Emitted when Coleman-Liau readability index (CLI) changes.
-     */
-    void readabilityIndexChanged(int value);
-
 public slots:
     /**
-     * Recalculates statistics text selected in the document's editor.
+     * Recalculates statistics for the text selected in the document's
+     * editor, between the given cursor positions.
      */
-    void onTextSelected
-    (
-        const QString &selectedText,
-        int selectionStart,
-        int selectionEnd
-    );
+    void onTextSelected(int selectionStart, int selectionEnd);
 
     /**
      * Reverts statistics to be for entire document after text has been
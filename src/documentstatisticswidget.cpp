@@ -87,6 +87,19 @@ DocumentStatisticsWidget::~DocumentStatisticsWidget()
 
 }
 
+void DocumentStatisticsWidget::setStatistics(const DocumentStatisticsData &statistics)
+{
+    setWordCount(statistics.wordCount);
+    setCharacterCount(statistics.characterCount);
+    setSentenceCount(statistics.sentenceCount);
+    setParagraphCount(statistics.paragraphCount);
+    setPageCount(statistics.pageCount);
+    setComplexWords(statistics.complexWords);
+    setReadingTime(statistics.readingTime);
+    setLixReadingEase(statistics.lixReadingEase);
+    setReadabilityIndex(statistics.readabilityIndex);
+}
+
 void DocumentStatisticsWidget::setWordCount(int value)
 {
     Q_D(DocumentStatisticsWidget);
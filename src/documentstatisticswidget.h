@@ -23,6 +23,7 @@
 #include <QScopedPointer>
 
 #include "abstractstatisticswidget.h"
+#include "documentstatistics.h"
 
 namespace ghostwriter
 {
@@ -47,6 +48,11 @@ public:
     virtual ~DocumentStatisticsWidget();
 
 public slots:
+    /**
+     * Sets all of the statistics to display at once.
+     */
+    void setStatistics(const DocumentStatisticsData &statistics);
+
     /**
      * Sets the word count to display.
      */
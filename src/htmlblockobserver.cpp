@@ -0,0 +1,144 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "htmlblockobserver.h"
+
+namespace ghostwriter
+{
+HtmlBlockObserver::HtmlBlockObserver(QObject *parent)
+    : QObject(parent), mRevision(0), mLastId(0)
+{
+    ;
+}
+
+HtmlBlockObserver::~HtmlBlockObserver()
+{
+    ;
+}
+
+void HtmlBlockObserver::setBlocks
+(
+    const QStringList &html,
+    const QVector<int> &startLines
+)
+{
+    int oldCount = mHtml.size();
+    int newCount = html.size();
+
+    // Find the blocks that are unchanged at the beginning and end.  Note
+    // that the HTML of blocks that weren't parsed again is shared with the
+    // prior AST's, making most comparisons trivial.
+    //
+    int prefix = 0;
+
+    while
+    (
+        (prefix < oldCount)
+        && (prefix < newCount)
+        && (mHtml[prefix] == html[prefix])
+    ) {
+        prefix++;
+    }
+
+    if ((prefix == oldCount) && (prefix == newCount)) {
+        return;
+    }
+
+    int suffix = 0;
+
+    while
+    (
+        (suffix < (oldCount - prefix))
+        && (suffix < (newCount - prefix))
+        && (mHtml[oldCount - 1 - suffix] == html[newCount - 1 - suffix])
+    ) {
+        suffix++;
+    }
+
+    int oldChanged = oldCount - prefix - suffix;
+    int newChanged = newCount - prefix - suffix;
+    int replaced = qMin(oldChanged, newChanged);
+
+    QStringList ids = mIds.mid(0, prefix);
+    QVariantList changes;
+
+    // Blocks in place of old ones keep their ids, while any remaining old
+    // blocks are removed and any remaining new ones are inserted.
+    //
+    for (int i = 0; i < replaced; i++) {
+        QVariantMap change;
+        QString id = mIds[prefix + i];
+
+        change.insert("type", "change");
+        change.insert("id", id);
+        change.insert("html", html[prefix + i]);
+        changes.append(change);
+        ids.append(id);
+    }
+
+    for (int i = replaced; i < oldChanged; i++) {
+        QVariantMap change;
+
+        change.insert("type", "remove");
+        change.insert("id", mIds[prefix + i]);
+        changes.append(change);
+    }
+
+    for (int i = replaced; i < newChanged; i++) {
+        QVariantMap change;
+        QString id = QString("block-%1-%2")
+            .arg(startLines.value(prefix + i))
+            .arg(++mLastId);
+
+        change.insert("type", "insert");
+        change.insert("id", id);
+        change.insert("after", ids.isEmpty() ? QString("") : ids.last());
+        change.insert("html", html[prefix + i]);
+        changes.append(change);
+        ids.append(id);
+    }
+
+    ids.append(mIds.mid(oldCount - suffix));
+
+    mHtml = html;
+    mIds = ids;
+    mRevision++;
+
+    emit blocksChanged(mRevision, changes);
+}
+
+QVariantMap HtmlBlockObserver::snapshot() const
+{
+    QVariantMap snapshot;
+    QVariantList blocks;
+
+    for (int i = 0; i < mHtml.size(); i++) {
+        QVariantMap block;
+
+        block.insert("id", mIds[i]);
+        block.insert("html", mHtml[i]);
+        blocks.append(block);
+    }
+
+    snapshot.insert("revision", mRevision);
+    snapshot.insert("blocks", blocks);
+
+    return snapshot;
+}
+} // namespace ghostwriter
@@ -0,0 +1,97 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef HTMLBLOCKOBSERVER_H
+#define HTMLBLOCKOBSERVER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
+
+namespace ghostwriter
+{
+/**
+ * Observer for the HTML of a document's top-level blocks.  Used in
+ * notifying web channel in QtWebEngine (Chromium) of only the blocks that
+ * were inserted, removed or changed, so that the page can update just
+ * those blocks rather than the whole document.
+ *
+ * Each block is given an id derived from the source line at which it
+ * started when it was inserted.  Blocks keep their ids for as long as
+ * they are neither removed nor replaced, even as lines are added or
+ * removed ahead of them.
+ */
+class HtmlBlockObserver : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit HtmlBlockObserver(QObject *parent = nullptr);
+
+    /**
+     * Destructor.
+     */
+    virtual ~HtmlBlockObserver();
+
+    /**
+     * Sets the HTML of each of the blocks, in order, along with the line
+     * of the source text at which each block starts.  Emits
+     * blocksChanged() with the changes since the blocks were last set,
+     * if any.
+     */
+    void setBlocks(const QStringList &html, const QVector<int> &startLines);
+
+    /**
+     * Returns the current revision of the blocks (as "revision"), along
+     * with the list of blocks (as "blocks"), each of which is a map of
+     * its "id" and "html".  For use by the page to display the blocks
+     * before applying any changes with a later revision.
+     */
+    Q_INVOKABLE QVariantMap snapshot() const;
+
+signals:
+    /**
+     * Emitted when the blocks change, with the revision of the blocks
+     * after the changes.  Each change is a map with a "type" of
+     * "remove", "change" or "insert", and the "id" of the block.
+     * Changed and inserted blocks also have their new "html", and
+     * inserted blocks have the id of the block to insert "after", which
+     * is empty for blocks inserted at the beginning.
+     */
+    void blocksChanged(int revision, const QVariantList &changes);
+
+private:
+    /*
+    * HTML and ids of the blocks, in order.
+    */
+    QStringList mHtml;
+    QStringList mIds;
+
+    int mRevision;
+    int mLastId;
+};
+} // namespace ghostwriter
+
+#endif // HTMLBLOCKOBSERVER_H
@@ -29,7 +29,9 @@
 #include <QFuture>
 #include <QWebChannel>
 
+#include "cmarkgfmexporter.h"
 #include "exporter.h"
+#include "htmlblockobserver.h"
 #include "htmlpreview.h"
 #include "sandboxedwebpage.h"
 #include "stringobserver.h"
@@ -57,7 +59,7 @@ public:
     MarkdownDocument *document;
     bool updateInProgress;
     bool updateAgain;
-    StringObserver livePreviewHtml;
+    HtmlBlockObserver livePreviewBlocks;
     StringObserver styleSheet;
     QString baseUrl;
     QRegularExpression headingTagExp;
@@ -67,6 +69,20 @@ public:
 
     void onHtmlReady();
     void onLoadFinished(bool ok);
+    void onMarkdownASTChanged();
+
+    /*
+    * Returns true if the HTML is taken from the document's AST snapshots,
+    * which the background parser renders with cmark-gfm, rather than
+    * being exported separately.
+    */
+    bool rendersFromDocument() const;
+
+    /*
+    * Displays the HTML rendered into the document's AST snapshot, provided
+    * the snapshot is up to date with the document's text.
+    */
+    void setHtmlFromDocument();
 
     /**
      * Sets the base directory path for determining resource
@@ -75,12 +91,18 @@ public:
      */
     void updateBaseDir();
     /*
-    * Sets the HTML contents to display, and creates a backup of the old
-    * HTML for diffing to scroll to the first difference whenever
-    * updatePreview() is called.
+    * Sets the HTML contents to display as a single block, such as for
+    * HTML that was not rendered block by block.
     */
     void setHtmlContent(const QString &html);
 
+    /*
+    * Sets the HTML of each of the top-level blocks of the document to
+    * display, along with the line at which each block starts.  Only the
+    * blocks that changed since the last update are sent to the page.
+    */
+    void setHtmlBlocks(const QStringList &html, const QVector<int> &startLines);
+
     QString exportToHtml(const QString &text, Exporter *exporter) const;
 };
 
@@ -100,7 +122,6 @@ HtmlPreview::HtmlPreview
     d->exporter = exporter;
 
     d->baseUrl = "";
-    d->livePreviewHtml.setText("");
     d->styleSheet.setText("");
 
     this->setPage(new SandboxedWebPage(this));
@@ -148,6 +169,15 @@ HtmlPreview::HtmlPreview
         }
     );
 
+    this->connect
+    (
+        document,
+        &MarkdownDocument::markdownASTChanged,
+        [d]() {
+            d->onMarkdownASTChanged();
+        }
+    );
+
     // Set zoom factor for Chromium browser to account for system DPI settings,
     // since Chromium assumes 96 DPI as a fixed resolution.
     //
@@ -156,7 +186,7 @@ HtmlPreview::HtmlPreview
 
     QWebChannel *channel = new QWebChannel(this);
     channel->registerObject(QStringLiteral("stylesheet"), &d->styleSheet);
-    channel->registerObject(QStringLiteral("livepreviewcontent"), &d->livePreviewHtml);
+    channel->registerObject(QStringLiteral("livepreviewcontent"), &d->livePreviewBlocks);
     this->page()->setWebChannel(channel);
 
     QFile wrapperHtmlFile(":/resources/preview.html");
@@ -190,7 +220,9 @@ void HtmlPreview::contextMenuEvent(QContextMenuEvent *event)
 void HtmlPreview::updatePreview()
 {
     Q_D(HtmlPreview);
-    
+
+    d->document->setHtmlRenderingEnabled(this->isVisible() && d->rendersFromDocument());
+
     if (d->updateInProgress) {
         d->updateAgain = true;
         return;
@@ -203,6 +235,11 @@ void HtmlPreview::updatePreview()
         //
         if (d->document->isEmpty()) {
             d->setHtmlContent("");
+        } else if (d->rendersFromDocument()) {
+            // The preview is otherwise updated once the background parser
+            // publishes the AST snapshot for the current text.
+            //
+            d->setHtmlFromDocument();
         } else if (nullptr != d->exporter) {
             QString text = d->document->toPlainText();
 
@@ -272,6 +309,51 @@ void HtmlPreviewPrivate::onLoadFinished(bool ok)
     }
 }
 
+void HtmlPreviewPrivate::onMarkdownASTChanged()
+{
+    Q_Q(HtmlPreview);
+
+    if (q->isVisible() && rendersFromDocument() && !document->isEmpty()) {
+        setHtmlFromDocument();
+    }
+}
+
+bool HtmlPreviewPrivate::rendersFromDocument() const
+{
+    return nullptr != dynamic_cast<CmarkGfmExporter *>(exporter);
+}
+
+void HtmlPreviewPrivate::setHtmlFromDocument()
+{
+    QSharedPointer<MarkdownAST> ast = document->markdownAST();
+
+    if
+    (
+        ast.isNull()
+        || !ast->hasHtml()
+        || (document->markdownASTRevision() != document->textRevision())
+    ) {
+        return;
+    }
+
+    if (ast->hasBlockHtml() && (nullptr != ast->root())) {
+        QVector<int> startLines;
+
+        for
+        (
+            MarkdownNode *block = ast->root()->firstChild();
+            nullptr != block;
+            block = block->next()
+        ) {
+            startLines.append(block->startLine());
+        }
+
+        setHtmlBlocks(ast->blockHtml(), startLines);
+    } else {
+        setHtmlContent(ast->html());
+    }
+}
+
 void HtmlPreviewPrivate::updateBaseDir()
 {
     Q_Q(HtmlPreview);
@@ -302,7 +384,20 @@ void HtmlPreview::closeEvent(QCloseEvent *event)
 
 void HtmlPreviewPrivate::setHtmlContent(const QString &html)
 {
-    this->livePreviewHtml.setText(html);
+    if (html.isEmpty()) {
+        setHtmlBlocks(QStringList(), QVector<int>());
+    } else {
+        setHtmlBlocks(QStringList(html), QVector<int>(1, 1));
+    }
+}
+
+void HtmlPreviewPrivate::setHtmlBlocks
+(
+    const QStringList &html,
+    const QVector<int> &startLines
+)
+{
+    this->livePreviewBlocks.setBlocks(html, startLines);
 }
 
 QString HtmlPreviewPrivate::exportToHtml
@@ -0,0 +1,173 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <algorithm>
+
+#include "linerangeset.h"
+
+namespace ghostwriter
+{
+LineRangeSet::LineRangeSet()
+{
+    ;
+}
+
+LineRangeSet::LineRangeSet(int firstLine, int lastLine)
+{
+    addRange(firstLine, lastLine);
+}
+
+LineRangeSet::~LineRangeSet()
+{
+    ;
+}
+
+bool LineRangeSet::isEmpty() const
+{
+    return ranges.isEmpty();
+}
+
+int LineRangeSet::rangeCount() const
+{
+    return ranges.size();
+}
+
+const LineRangeSet::LineRange &LineRangeSet::rangeAt(int index) const
+{
+    return ranges[index];
+}
+
+int LineRangeSet::firstLine() const
+{
+    if (ranges.isEmpty()) {
+        return 0;
+    }
+
+    return ranges.first().firstLine;
+}
+
+int LineRangeSet::lastLine() const
+{
+    if (ranges.isEmpty()) {
+        return 0;
+    }
+
+    return ranges.last().lastLine;
+}
+
+bool LineRangeSet::contains(int line) const
+{
+    QVector<LineRange>::const_iterator range =
+        std::lower_bound
+        (
+            ranges.constBegin(),
+            ranges.constEnd(),
+            line,
+            [](const LineRange &range, int line) {
+                return range.lastLine < line;
+            }
+        );
+
+    return (ranges.constEnd() != range) && (range->firstLine <= line);
+}
+
+void LineRangeSet::addRange(int firstLine, int lastLine)
+{
+    if (lastLine < firstLine) {
+        return;
+    }
+
+    // Lines are usually added in order, so check for the range
+    // joining onto or following the last one first.
+    //
+    if (ranges.isEmpty() || (firstLine > (ranges.last().lastLine + 1))) {
+        ranges.append({firstLine, lastLine});
+        return;
+    }
+
+    if (firstLine >= ranges.last().firstLine) {
+        ranges.last().lastLine = qMax(ranges.last().lastLine, lastLine);
+        return;
+    }
+
+    // Merge the new range with every range that it overlaps or touches.
+    int first = 0;
+
+    while ((first < ranges.size()) && ((ranges[first].lastLine + 1) < firstLine)) {
+        first++;
+    }
+
+    int last = first;
+
+    while ((last < ranges.size()) && (ranges[last].firstLine <= (lastLine + 1))) {
+        firstLine = qMin(firstLine, ranges[last].firstLine);
+        lastLine = qMax(lastLine, ranges[last].lastLine);
+        last++;
+    }
+
+    if (last > first) {
+        ranges[first] = {firstLine, lastLine};
+        ranges.remove(first + 1, last - first - 1);
+    } else {
+        ranges.insert(first, {firstLine, lastLine});
+    }
+}
+
+void LineRangeSet::unite(const LineRangeSet &other)
+{
+    foreach (const LineRange &range, other.ranges) {
+        addRange(range.firstLine, range.lastLine);
+    }
+}
+
+void LineRangeSet::applyEdit
+(
+    int unchangedHeadLines,
+    int unchangedTailLines,
+    int lineCount,
+    int lineDelta
+)
+{
+    int oldTailStart = lineCount - lineDelta - unchangedTailLines + 1;
+    int editedFirstLine = unchangedHeadLines + 1;
+    int editedLastLine = qMax(lineCount - unchangedTailLines, editedFirstLine);
+    QVector<LineRange> oldRanges = ranges;
+
+    ranges.clear();
+
+    foreach (const LineRange &range, oldRanges) {
+        int firstLine = range.firstLine;
+        int lastLine = range.lastLine;
+
+        if (firstLine >= oldTailStart) {
+            firstLine += lineDelta;
+        } else if (firstLine > unchangedHeadLines) {
+            firstLine = editedFirstLine;
+        }
+
+        if (lastLine >= oldTailStart) {
+            lastLine += lineDelta;
+        } else if (lastLine > unchangedHeadLines) {
+            lastLine = editedLastLine;
+        }
+
+        addRange(qMax(firstLine, 1), qMin(lastLine, lineCount));
+    }
+}
+} // namespace ghostwriter
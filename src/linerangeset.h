@@ -0,0 +1,125 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef LINE_RANGE_SET_H
+#define LINE_RANGE_SET_H
+
+#include <QMetaType>
+#include <QVector>
+
+namespace ghostwriter
+{
+/**
+ * A set of line numbers (starting at 1), stored as sorted, disjoint
+ * ranges of consecutive lines.  Use this class to track which lines of
+ * a text changed between two revisions of it.
+ */
+class LineRangeSet
+{
+public:
+    /**
+     * A range of consecutive lines (inclusive).
+     */
+    typedef struct
+    {
+        int firstLine;
+        int lastLine;
+    } LineRange;
+
+    /**
+     * Constructor.  Creates an empty set.
+     */
+    LineRangeSet();
+
+    /**
+     * Constructor.  Creates a set holding the given lines (inclusive).
+     */
+    LineRangeSet(int firstLine, int lastLine);
+
+    /**
+     * Destructor.
+     */
+    ~LineRangeSet();
+
+    /**
+     * Returns true if the set holds no lines.
+     */
+    bool isEmpty() const;
+
+    /**
+     * Returns the number of disjoint ranges in the set.
+     */
+    int rangeCount() const;
+
+    /**
+     * Returns the range at the given index.  Ranges are sorted by line
+     * and never overlap or touch one another.
+     */
+    const LineRange &rangeAt(int index) const;
+
+    /**
+     * Returns the first line of the set, or 0 if the set is empty.
+     */
+    int firstLine() const;
+
+    /**
+     * Returns the last line of the set, or 0 if the set is empty.
+     */
+    int lastLine() const;
+
+    /**
+     * Returns true if the set holds the given line.
+     */
+    bool contains(int line) const;
+
+    /**
+     * Adds the given lines (inclusive) to the set.  Ranges that are
+     * added in order of their lines are appended in constant time.
+     */
+    void addRange(int firstLine, int lastLine);
+
+    /**
+     * Adds all lines of the given set to this one.
+     */
+    void unite(const LineRangeSet &other);
+
+    /**
+     * Maps the lines of this set through an edit of the text, after
+     * which the text has lineCount lines, lineDelta of which were added
+     * (or, if negative, removed).  The first unchangedHeadLines and last
+     * unchangedTailLines of the text were left as they were.  Lines that
+     * were within the edited text are moved into the edited lines of
+     * the new text.
+     */
+    void applyEdit
+    (
+        int unchangedHeadLines,
+        int unchangedTailLines,
+        int lineCount,
+        int lineDelta
+    );
+
+private:
+    QVector<LineRange> ranges;
+};
+} // namespace ghostwriter
+
+Q_DECLARE_METATYPE(ghostwriter::LineRangeSet)
+
+#endif
@@ -328,6 +328,33 @@ MainWindow::MainWindow(const QString &filePath, QWidget *parent)
 
     buildMenuBar();
     buildStatusBar();
+
+    // Show dictionaries loading in the background as an operation in
+    // progress.  Queue the updates, since dictionaries are requested
+    // from deep within other operations.
+    //
+    connect
+    (
+        &DictionaryManager::instance(),
+        &DictionaryManager::loadingStarted,
+        this,
+        [this]() {
+            onOperationStarted(tr("loading dictionary"));
+        },
+        Qt::QueuedConnection
+    );
+    connect
+    (
+        &DictionaryManager::instance(),
+        &DictionaryManager::loadingFinished,
+        this,
+        &MainWindow::onOperationFinished,
+        Qt::QueuedConnection
+    );
+
+    if (DictionaryManager::instance().isLoading()) {
+        onOperationStarted(tr("loading dictionary"));
+    }
     
     QVBoxLayout *mainLayout = new QVBoxLayout();
     QWidget *mainPane = new QWidget(this);
@@ -1370,25 +1397,9 @@ void MainWindow::buildSidebar()
     outlineWidget->setAlternatingRowColors(false);
 
     documentStats = new DocumentStatistics((MarkdownDocument *) editor->document(), this);
-    connect(documentStats, &DocumentStatistics::wordCountChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setWordCount);
-    connect(documentStats, &DocumentStatistics::characterCountChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setCharacterCount);
-    connect(documentStats, &DocumentStatistics::sentenceCountChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setSentenceCount);
-    connect(documentStats, &DocumentStatistics::paragraphCountChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setParagraphCount);
-    connect(documentStats, &DocumentStatistics::pageCountChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setPageCount);
-    connect(documentStats, &DocumentStatistics::complexWordsChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setComplexWords);
-    connect(documentStats, &DocumentStatistics::readingTimeChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setReadingTime);
-    connect(documentStats, &DocumentStatistics::lixReadingEaseChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setLixReadingEase);
-    connect(documentStats, &DocumentStatistics::readabilityIndexChanged,
-            documentStatsWidget, &DocumentStatisticsWidget::setReadabilityIndex);
-    connect(editor, SIGNAL(textSelected(QString, int, int)), documentStats, SLOT(onTextSelected(QString, int, int)));
+    connect(documentStats, &DocumentStatistics::statisticsChanged,
+            documentStatsWidget, &DocumentStatisticsWidget::setStatistics);
+    connect(editor, SIGNAL(textSelected(int, int)), documentStats, SLOT(onTextSelected(int, int)));
     connect(editor, SIGNAL(textDeselected()), documentStats, SLOT(onTextDeselected()));
 
     sessionStats = new SessionStatistics(this);
@@ -17,11 +17,16 @@
  *
  ***********************************************************************/
 
+#include <algorithm>
+#include <limits>
+
+#include <QHash>
 #include <QStack>
 #include <QTextStream>
 #include <QtGlobal>
 
 #include "3rdparty/cmark-gfm/src/cmark-gfm.h"
+#include "3rdparty/cmark-gfm/src/cmark-gfm-extension_api.h"
 
 #include "markdownast.h"
 
@@ -31,6 +36,8 @@ class MarkdownASTPrivate
 {
 public:
     MarkdownASTPrivate()
+        : root(nullptr),
+          htmlPerBlock(false)
     {
         ;
     }
@@ -40,77 +47,396 @@ public:
         ;
     }
 
-    MemoryArena<MarkdownNode> arena;
+    /*
+     * Index of a container's children, used to find the first child
+     * that the search for the block at a given line can stop at without
+     * walking the preceding children.  Entry i of reach holds the
+     * maximum, over children 0 to i, of the last line that child can be
+     * matched against, so that it is sorted even when child line ranges
+     * are open-ended.
+     */
+    typedef struct
+    {
+        QVector<qint32> children;
+        QVector<int> reach;
+    } ChildIndex;
+
+    // Containers with fewer children than this are searched linearly.
+    static const int MinIndexedChildren = 16;
+
+    // All nodes of the tree, with the root first.  Nodes link to each
+    // other by index, so the storage may grow while the tree is built.
+    //
+    QVector<MarkdownNode> nodes;
+
+    // Address of the root node, set once the tree is built.
     MarkdownNode *root;
+
+    // Original Markdown text and the position at which each of its
+    // lines starts.
+    //
+    QString text;
+    QVector<int> lineStarts;
+
+    // Node text that does not appear verbatim in the Markdown text.
+    QString textPool;
+
+    // HTML rendered from the AST, along with that of each top-level
+    // block if they were rendered separately.
+    //
+    QString html;
+    QStringList blockHtml;
+    bool htmlPerBlock;
+
+    QHash<qint32, ChildIndex> childIndexes;
+
+    qint32 allocate();
+    void setText(const QString &text);
+    QStringRef lineText(int lineNumber) const;
+    void copyTextFrom(MarkdownNode &node, cmark_node *source);
+    bool matchesText(const char *literal, int lineNumber, int column, int &length) const;
+    qint32 copyNode(const MarkdownASTPrivate *from, const MarkdownNode *source, int lineOffset);
+    qint32 clone(const MarkdownASTPrivate *from, const MarkdownNode *source, int lineOffset);
+    void appendClones(const MarkdownASTPrivate *from, const MarkdownNode *parent, int lineOffset);
+    void buildIndex();
+    static int reachOf(const MarkdownNode *node);
+    MarkdownNode *firstReachingChild(const MarkdownNode *parent, int lineNumber) const;
+    MarkdownNode *findBlockFrom(MarkdownNode *current, int lineNumber) const;
 };
 
 MarkdownAST::MarkdownAST()
     : d_ptr(new MarkdownASTPrivate())
 {
-    Q_D(MarkdownAST);
-    
-    d->root = nullptr;
+    ;
 }
 
-MarkdownAST::MarkdownAST(cmark_node *root)
-    : d_ptr(new MarkdownASTPrivate())
-{    
-    setRoot(root);
+MarkdownAST::MarkdownAST
+(
+    cmark_node *root,
+    const QString &text,
+    const Utf8ColumnMap &columnMap,
+    int nodeCountHint
+) : d_ptr(new MarkdownASTPrivate())
+{
+    setRoot(root, text, columnMap, nodeCountHint);
 }
 
 MarkdownAST::~MarkdownAST()
 {
-    Q_D(MarkdownAST);
-    
-    d->arena.freeAll();
-    d->root = nullptr;
+    ;
 }
 
-MarkdownNode *MarkdownAST::root()
+MarkdownNode *MarkdownAST::root() const
 {
-    Q_D(MarkdownAST);
+    Q_D(const MarkdownAST);
     
     return d->root;
 }
 
-void MarkdownAST::setRoot(cmark_node *root)
+void MarkdownAST::setRoot
+(
+    cmark_node *root,
+    const QString &text,
+    const Utf8ColumnMap &columnMap,
+    int nodeCountHint
+)
 {
     Q_D(MarkdownAST);
     
-    d->arena.freeAll();
+    clear();
+    d->setText(text);
 
     if (nullptr == root) {
-        d->root = nullptr;
         return;
     }
 
-    d->root = d->arena.allocate();
+    if (nodeCountHint > 0) {
+        d->nodes.reserve(nodeCountHint);
+    }
 
-    // Clone the node into memory that isn't allocated to
-    // cmark-gfm's arena memory.
-    QStack<cmark_node *> fromNodes;
-    QStack<MarkdownNode *> toNodes;
+    // Clone the nodes into memory that isn't allocated to cmark-gfm's
+    // arena memory in a single pre-order pass.  The stack holds the
+    // chain of ancestors of the current node, each paired with the
+    // index of its clone.
+    //
+    QVector<cmark_node *> ancestors;
+    QVector<qint32> ancestorClones;
+    cmark_iter *iter = cmark_iter_new(root);
+    cmark_event_type event;
+
+    while (CMARK_EVENT_DONE != (event = cmark_iter_next(iter))) {
+        if (CMARK_EVENT_ENTER != event) {
+            continue;
+        }
 
-    fromNodes.push(root);
-    toNodes.push(d->root);
+        cmark_node *source = cmark_iter_get_node(iter);
+        cmark_node *parent = cmark_node_parent(source);
 
-    while (!fromNodes.isEmpty()) {
-        cmark_node *source = fromNodes.pop();
-        MarkdownNode *dest = toNodes.pop();
+        while (!ancestors.isEmpty() && (ancestors.last() != parent)) {
+            ancestors.removeLast();
+            ancestorClones.removeLast();
+        }
+
+        qint32 dest = d->allocate();
+        d->nodes[dest].setDataFrom(source, columnMap);
+        d->copyTextFrom(d->nodes[dest], source);
+
+        if (!ancestorClones.isEmpty()) {
+            d->nodes[ancestorClones.last()].appendChild(&d->nodes[dest]);
+        }
+
+        ancestors.append(source);
+        ancestorClones.append(dest);
+    }
+
+    cmark_iter_free(iter);
+
+    d->root = d->nodes.data();
+    d->buildIndex();
+}
+
+MarkdownAST *MarkdownAST::replaceBlocks
+(
+    int firstLine,
+    int lastLine,
+    int lineDelta,
+    const MarkdownAST *blocks,
+    const QString &newText
+) const
+{
+    Q_D(const MarkdownAST);
+
+    MarkdownAST *ast = new MarkdownAST();
+    MarkdownASTPrivate *astData = ast->d_func();
+
+    astData->setText(newText);
+
+    if (nullptr == d->root) {
+        return ast;
+    }
+
+    const MarkdownASTPrivate *blocksData = nullptr;
+    const MarkdownNode *newRoot = nullptr;
+
+    if (nullptr != blocks) {
+        blocksData = blocks->d_func();
+        newRoot = blocksData->root;
+    }
+
+    astData->nodes.reserve
+    (
+        d->nodes.size() + ((nullptr == blocksData) ? 0 : blocksData->nodes.size())
+    );
+
+    astData->copyNode(d, d->root, 0);
+
+    // The HTML of each block carries over with it, provided both
+    // ASTs had their blocks rendered separately.
+    //
+    bool spliceHtml =
+        d->htmlPerBlock
+        && ((nullptr == blocksData) || blocksData->htmlPerBlock);
+    QStringList blockHtml;
+
+    bool inserted = (nullptr == newRoot);
+    const MarkdownNode *node = d->root->firstChild();
+    int blockIndex = 0;
+
+    while (nullptr != node) {
+        if (node->startLine() > lastLine) {
+            // Insert the new blocks ahead of the first block that
+            // follows the replaced lines.
+            //
+            if (!inserted) {
+                astData->appendClones(blocksData, newRoot, firstLine - 1);
+
+                if (spliceHtml && (nullptr != blocksData)) {
+                    blockHtml.append(blocksData->blockHtml);
+                }
+
+                inserted = true;
+            }
+
+            qint32 clonedNode = astData->clone(d, node, lineDelta);
+            astData->nodes[0].appendChild(&astData->nodes[clonedNode]);
+            blockHtml.append(d->blockHtml.value(blockIndex));
+        } else if (node->startLine() < firstLine) {
+            qint32 clonedNode = astData->clone(d, node, 0);
+            astData->nodes[0].appendChild(&astData->nodes[clonedNode]);
+            blockHtml.append(d->blockHtml.value(blockIndex));
+        }
+
+        node = node->next();
+        blockIndex++;
+    }
+
+    if (!inserted) {
+        astData->appendClones(blocksData, newRoot, firstLine - 1);
+
+        if (spliceHtml && (nullptr != blocksData)) {
+            blockHtml.append(blocksData->blockHtml);
+        }
+    }
+
+    astData->root = astData->nodes.data();
+    astData->buildIndex();
+
+    if (spliceHtml && (d->blockHtml.size() == blockIndex)) {
+        ast->setBlockHtml(blockHtml);
+    }
+
+    return ast;
+}
+
+MarkdownAST *MarkdownAST::join
+(
+    const QVector<MarkdownAST *> &chunks,
+    const QVector<int> &firstLines,
+    const QVector<int> &lineOffsets,
+    const QString &text
+)
+{
+    MarkdownAST *ast = new MarkdownAST();
+    MarkdownASTPrivate *astData = ast->d_func();
+
+    astData->setText(text);
+
+    if (chunks.isEmpty() || (nullptr == chunks.last()->d_func()->root)) {
+        return ast;
+    }
+
+    int nodeCount = 0;
+    bool joinHtml = true;
+
+    foreach (const MarkdownAST *chunk, chunks) {
+        nodeCount += chunk->d_func()->nodes.size();
+        joinHtml = joinHtml && chunk->d_func()->htmlPerBlock;
+    }
+
+    astData->nodes.reserve(nodeCount);
+
+    // The document node spans from the first line of the text to the
+    // end of the last chunk.
+    //
+    const MarkdownASTPrivate *lastData = chunks.last()->d_func();
+
+    astData->copyNode(lastData, lastData->root, lineOffsets.last());
+    astData->nodes[0].m_startLine = 1;
+    astData->nodes[0].m_position = 0;
+
+    QStringList blockHtml;
+
+    for (int i = 0; i < chunks.size(); i++) {
+        const MarkdownASTPrivate *chunkData = chunks[i]->d_func();
+
+        if (nullptr == chunkData->root) {
+            continue;
+        }
+
+        const MarkdownNode *block = chunkData->root->firstChild();
+        int blockIndex = 0;
+
+        while (nullptr != block) {
+            if (block->startLine() >= firstLines[i]) {
+                qint32 clonedBlock = astData->clone(chunkData, block, lineOffsets[i]);
+                astData->nodes[0].appendChild(&astData->nodes[clonedBlock]);
+
+                if (joinHtml) {
+                    blockHtml.append(chunkData->blockHtml.value(blockIndex));
+                }
+            }
+
+            block = block->next();
+            blockIndex++;
+        }
+    }
+
+    astData->root = astData->nodes.data();
+    astData->buildIndex();
+
+    if (joinHtml) {
+        ast->setBlockHtml(blockHtml);
+    }
+
+    return ast;
+}
+
+int MarkdownAST::nodeCount() const
+{
+    Q_D(const MarkdownAST);
+
+    return d->nodes.size();
+}
+
+bool MarkdownAST::hasHtml() const
+{
+    Q_D(const MarkdownAST);
+
+    return !d->html.isNull();
+}
+
+QString MarkdownAST::html() const
+{
+    Q_D(const MarkdownAST);
+
+    return d->html;
+}
+
+bool MarkdownAST::hasBlockHtml() const
+{
+    Q_D(const MarkdownAST);
+
+    return d->htmlPerBlock;
+}
+
+QStringList MarkdownAST::blockHtml() const
+{
+    Q_D(const MarkdownAST);
+
+    return d->blockHtml;
+}
+
+void MarkdownAST::setBlockHtml(const QStringList &blockHtml)
+{
+    Q_D(MarkdownAST);
+
+    d->blockHtml = blockHtml;
+    d->htmlPerBlock = true;
+    d->html = blockHtml.join(QString());
+
+    // An empty document still has (empty) HTML.
+    if (d->html.isNull()) {
+        d->html = QString("");
+    }
+}
+
+void MarkdownAST::setHtml(const QString &html)
+{
+    Q_D(MarkdownAST);
+
+    d->blockHtml.clear();
+    d->htmlPerBlock = false;
+    d->html = html;
+}
 
-        dest->setDataFrom(source);
+QStringRef MarkdownAST::text(const MarkdownNode *node) const
+{
+    Q_D(const MarkdownAST);
 
-        // Prep children nodes for cloning.
-        MarkdownNode *destParent = dest;
-        source = cmark_node_first_child(source);
+    switch (node->m_textStorage) {
+    case MarkdownNode::SourceText: {
+        QStringRef line = d->lineText(node->m_startLine);
 
-        while (NULL != source) {
-            fromNodes.push(source);
-            dest = d->arena.allocate();
-            destParent->appendChild(dest);
-            toNodes.push(dest);
-            source = cmark_node_next(source);
+        if (line.isNull()) {
+            return QStringRef();
         }
+
+        return QStringRef(&d->text, line.position() + node->m_textOffset, node->m_textLength);
+    }
+    case MarkdownNode::PooledText:
+        return QStringRef(&d->textPool, node->m_textOffset, node->m_textLength);
+    default:
+        return QStringRef();
     }
 }
 
@@ -122,54 +448,49 @@ MarkdownNode *MarkdownAST::findBlockAtLine(int lineNumber) const
         return nullptr;
     }
 
-    MarkdownNode *candidate = nullptr;
-    MarkdownNode *current = d->root->firstChild();
+    return d->findBlockFrom(d->firstReachingChild(d->root, lineNumber), lineNumber);
+}
 
-    while
+QVector<MarkdownNode *> MarkdownAST::findBlocksInLineRange(int firstLine, int lastLine) const
+{
+    Q_D(const MarkdownAST);
+
+    QVector<MarkdownNode *> blocks;
+
+    if
     (
-        (nullptr != current)
-        && (current->isBlockType())
-        && (MarkdownNode::TableCell != current->type())
+        (nullptr == d->root)
+        || (MarkdownNode::Invalid == d->root->type())
+        || (lastLine < firstLine)
     ) {
-        if
-        (
-            (current->startLine() <= lineNumber)
-            &&
-            (
-                (lineNumber <= current->endLine())
-                || (0 == current->endLine())
-            )
-        ) {
-            candidate = current;
+        return blocks;
+    }
 
-            switch (current->type()) {
-            case MarkdownNode::ListItem:
-            case MarkdownNode::TaskListItem:
-                return candidate;
-            case MarkdownNode::Heading: {
-                int lineCount = current->endLine() - current->startLine() + 1;
+    blocks.reserve(lastLine - firstLine + 1);
 
-                if (
-                    (lineCount > 2) &&
-                    (lineNumber == current->endLine())) {
-                    current = current->next();
-                } else {
-                    current = current->firstChild();
-                }
-                break;
-            }
-            default:
-                current = current->firstChild();
-                break;
-            }
-        } else if (current->startLine() > lineNumber) {
-            return candidate;
-        } else {
-            current = current->next();
+    // The first top-level block reaching each line only moves forward
+    // as the line number increases, so walk the top-level index once
+    // rather than searching it for every line.
+    //
+    const MarkdownASTPrivate::ChildIndex topLevel = d->childIndexes.value(d->root->m_index);
+    int i = std::lower_bound(topLevel.reach.constBegin(), topLevel.reach.constEnd(), firstLine)
+        - topLevel.reach.constBegin();
+
+    for (int line = firstLine; line <= lastLine; line++) {
+        while ((i < topLevel.reach.size()) && (topLevel.reach[i] < line)) {
+            i++;
         }
+
+        MarkdownNode *first = nullptr;
+
+        if (i < topLevel.children.size()) {
+            first = d->root + topLevel.children[i];
+        }
+
+        blocks.append(d->findBlockFrom(first, line));
     }
 
-    return candidate;
+    return blocks;
 }
 
 QVector<MarkdownNode *> MarkdownAST::headings() const
@@ -199,8 +520,15 @@ void MarkdownAST::clear()
 {
     Q_D(MarkdownAST);
     
-    d->arena.freeAll();
+    d->nodes.clear();
     d->root = nullptr;
+    d->text.clear();
+    d->lineStarts.clear();
+    d->textPool.clear();
+    d->html = QString();
+    d->blockHtml.clear();
+    d->htmlPerBlock = false;
+    d->childIndexes.clear();
 }
 
 QString MarkdownAST::toString() const
@@ -222,12 +550,17 @@ QString MarkdownAST::toString() const
     while (!nodes.empty()) {
         MarkdownNode *node = nodes.pop();
         QString indent = indentation.pop();
+        QStringRef nodeText = this->text(node);
 
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
-        stream << indent << "->" << node->toString() << Qt::endl;
+        stream << indent << "->" << node->toString() << " -> "
+            << (nodeText.isNull() ? QString("<<Empty Node>>") : nodeText.toString())
+            << Qt::endl;
 #else
-        stream << indent << "->" << node->toString() << endl;
+        stream << indent << "->" << node->toString() << " -> "
+            << (nodeText.isNull() ? QString("<<Empty Node>>") : nodeText.toString())
+            << endl;
 #endif
 
         MarkdownNode *child = node->lastChild();
@@ -242,4 +575,360 @@ QString MarkdownAST::toString() const
 
     return text;
 }
+
+qint32 MarkdownASTPrivate::allocate()
+{
+    qint32 index = nodes.size();
+
+    nodes.append(MarkdownNode());
+    nodes[index].m_index = index;
+
+    return index;
+}
+
+void MarkdownASTPrivate::setText(const QString &text)
+{
+    this->text = text;
+    lineStarts.clear();
+    lineStarts.append(0);
+
+    // Break lines the same way cmark-gfm does.
+    for (int i = 0; i < text.length(); i++) {
+        if ('\r' == text[i]) {
+            if (((i + 1) < text.length()) && ('\n' == text[i + 1])) {
+                i++;
+            }
+
+            lineStarts.append(i + 1);
+        } else if ('\n' == text[i]) {
+            lineStarts.append(i + 1);
+        }
+    }
+}
+
+QStringRef MarkdownASTPrivate::lineText(int lineNumber) const
+{
+    if ((lineNumber < 1) || (lineNumber > lineStarts.size())) {
+        return QStringRef();
+    }
+
+    int start = lineStarts[lineNumber - 1];
+    int end = text.length();
+
+    if (lineNumber < lineStarts.size()) {
+        end = lineStarts[lineNumber];
+    }
+
+    return QStringRef(&text, start, end - start);
+}
+
+void MarkdownASTPrivate::copyTextFrom(MarkdownNode &node, cmark_node *source)
+{
+    const char *literal = nullptr;
+
+    if (MarkdownNode::Heading == node.type()) {
+        literal = cmark_node_get_string_content(source);
+    } else if (!node.isBlockType()) {
+        literal = cmark_node_get_literal(source);
+    }
+
+    if (nullptr == literal) {
+        return;
+    }
+
+    int length = 0;
+
+    // Most literals are found exactly where their node begins, and can
+    // be matched without decoding them.
+    //
+    if
+    (
+        (MarkdownNode::Heading != node.type())
+        && matchesText(literal, node.startLine(), node.position(), length)
+    ) {
+        node.m_textStorage = MarkdownNode::SourceText;
+        node.m_textOffset = node.position();
+        node.m_textLength = length;
+        return;
+    }
+
+    QString literalText = QString::fromUtf8(literal);
+
+    if (MarkdownNode::Heading == node.type()) {
+        literalText = literalText.simplified();
+    }
+
+    // Otherwise look for the literal further along the node's line,
+    // such as after the opening backticks of a code span.
+    //
+    QStringRef line = lineText(node.startLine());
+    int column = line.indexOf(literalText, qMax(node.position(), 0));
+    int end = line.length();
+
+    if (node.startLine() == node.endLine()) {
+        end = qMin(end, node.position() + node.length());
+    }
+
+    if ((column >= 0) && ((column + literalText.length()) <= end)) {
+        node.m_textStorage = MarkdownNode::SourceText;
+        node.m_textOffset = column;
+        node.m_textLength = literalText.length();
+        return;
+    }
+
+    // The literal differs from the Markdown text, such as when it
+    // contains escaped characters or entities, so keep a copy of it.
+    //
+    node.m_textStorage = MarkdownNode::PooledText;
+    node.m_textOffset = textPool.length();
+    node.m_textLength = literalText.length();
+    textPool.append(literalText);
+}
+
+bool MarkdownASTPrivate::matchesText
+(
+    const char *literal,
+    int lineNumber,
+    int column,
+    int &length
+) const
+{
+    QStringRef line = lineText(lineNumber);
+
+    if (column < 0) {
+        return false;
+    }
+
+    int i = 0;
+
+    for (; '\0' != literal[i]; i++) {
+        uchar c = literal[i];
+
+        // Leave multi-byte characters to the caller to decode.
+        if ((c >= 0x80) || ((column + i) >= line.length()) || (line.at(column + i) != QChar(c))) {
+            return false;
+        }
+    }
+
+    length = i;
+    return true;
+}
+
+qint32 MarkdownASTPrivate::copyNode
+(
+    const MarkdownASTPrivate *from,
+    const MarkdownNode *source,
+    int lineOffset
+)
+{
+    qint32 index = nodes.size();
+    MarkdownNode node = *source;
+
+    node.m_index = index;
+    node.m_parent = MarkdownNode::NoNode;
+    node.m_prev = MarkdownNode::NoNode;
+    node.m_next = MarkdownNode::NoNode;
+    node.m_firstChild = MarkdownNode::NoNode;
+    node.m_lastChild = MarkdownNode::NoNode;
+    node.shiftLines(lineOffset);
+
+    // Text spans of the Markdown text are relative to the node's line,
+    // and so remain valid once the line is shifted.  Pooled text must
+    // be copied into this AST's pool.
+    //
+    if (MarkdownNode::PooledText == node.m_textStorage) {
+        node.m_textOffset = textPool.length();
+        textPool.append(from->textPool.midRef(source->m_textOffset, source->m_textLength));
+    }
+
+    nodes.append(node);
+    return index;
+}
+
+qint32 MarkdownASTPrivate::clone
+(
+    const MarkdownASTPrivate *from,
+    const MarkdownNode *source,
+    int lineOffset
+)
+{
+    qint32 clonedRoot = copyNode(from, source, lineOffset);
+
+    QStack<const MarkdownNode *> fromNodes;
+    QStack<qint32> toNodes;
+
+    fromNodes.push(source);
+    toNodes.push(clonedRoot);
+
+    while (!fromNodes.isEmpty()) {
+        const MarkdownNode *fromNode = fromNodes.pop();
+        qint32 dest = toNodes.pop();
+
+        for
+        (
+            const MarkdownNode *child = fromNode->firstChild();
+            nullptr != child;
+            child = child->next()
+        ) {
+            qint32 childIndex = copyNode(from, child, lineOffset);
+            nodes[dest].appendChild(&nodes[childIndex]);
+            fromNodes.push(child);
+            toNodes.push(childIndex);
+        }
+    }
+
+    return clonedRoot;
+}
+
+void MarkdownASTPrivate::appendClones
+(
+    const MarkdownASTPrivate *from,
+    const MarkdownNode *parent,
+    int lineOffset
+)
+{
+    const MarkdownNode *child = parent->firstChild();
+
+    while (nullptr != child) {
+        qint32 clonedChild = clone(from, child, lineOffset);
+        nodes[0].appendChild(&nodes[clonedChild]);
+        child = child->next();
+    }
+}
+
+void MarkdownASTPrivate::buildIndex()
+{
+    childIndexes.clear();
+
+    if (nullptr == root) {
+        return;
+    }
+
+    QStack<const MarkdownNode *> parents;
+    parents.push(root);
+
+    while (!parents.isEmpty()) {
+        const MarkdownNode *parent = parents.pop();
+        int childCount = 0;
+
+        for (MarkdownNode *child = parent->firstChild(); nullptr != child; child = child->next()) {
+            if (nullptr != child->firstChild()) {
+                parents.push(child);
+            }
+
+            childCount++;
+        }
+
+        // Always index the top-level blocks, since every search
+        // begins with them.
+        //
+        if ((root != parent) && (childCount < MinIndexedChildren)) {
+            continue;
+        }
+
+        ChildIndex &index = childIndexes[parent->m_index];
+        index.children.reserve(childCount);
+        index.reach.reserve(childCount);
+
+        int reach = 0;
+
+        for (MarkdownNode *child = parent->firstChild(); nullptr != child; child = child->next()) {
+            reach = qMax(reach, reachOf(child));
+            index.children.append(child->m_index);
+            index.reach.append(reach);
+        }
+    }
+}
+
+int MarkdownASTPrivate::reachOf(const MarkdownNode *node)
+{
+    // The search for the block at a line stops at the first node
+    // that matches the line or starts after it, or that is not a
+    // block it can descend into.
+    //
+    if (!node->isBlockType() || (MarkdownNode::TableCell == node->type())) {
+        return std::numeric_limits<int>::max();
+    }
+
+    if (0 == node->endLine()) {
+        return std::numeric_limits<int>::max();
+    }
+
+    return qMax(node->endLine(), node->startLine() - 1);
+}
+
+MarkdownNode *MarkdownASTPrivate::firstReachingChild
+(
+    const MarkdownNode *parent,
+    int lineNumber
+) const
+{
+    QHash<qint32, ChildIndex>::const_iterator index =
+        childIndexes.constFind(parent->m_index);
+
+    if (childIndexes.constEnd() == index) {
+        return parent->firstChild();
+    }
+
+    const QVector<int> &reach = index->reach;
+    int i = std::lower_bound(reach.constBegin(), reach.constEnd(), lineNumber)
+        - reach.constBegin();
+
+    if (i >= reach.size()) {
+        return nullptr;
+    }
+
+    return root + index->children[i];
+}
+
+MarkdownNode *MarkdownASTPrivate::findBlockFrom(MarkdownNode *current, int lineNumber) const
+{
+    MarkdownNode *candidate = nullptr;
+
+    while
+    (
+        (nullptr != current)
+        && (current->isBlockType())
+        && (MarkdownNode::TableCell != current->type())
+    ) {
+        if
+        (
+            (current->startLine() <= lineNumber)
+            &&
+            (
+                (lineNumber <= current->endLine())
+                || (0 == current->endLine())
+            )
+        ) {
+            candidate = current;
+
+            switch (current->type()) {
+            case MarkdownNode::ListItem:
+            case MarkdownNode::TaskListItem:
+                return candidate;
+            case MarkdownNode::Heading: {
+                int lineCount = current->endLine() - current->startLine() + 1;
+
+                if (
+                    (lineCount > 2) &&
+                    (lineNumber == current->endLine())) {
+                    current = current->next();
+                } else {
+                    current = firstReachingChild(current, lineNumber);
+                }
+                break;
+            }
+            default:
+                current = firstReachingChild(current, lineNumber);
+                break;
+            }
+        } else if (current->startLine() > lineNumber) {
+            return candidate;
+        } else {
+            current = current->next();
+        }
+    }
+
+    return candidate;
+}
 } // namespace ghostwriter
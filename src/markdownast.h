@@ -21,9 +21,12 @@
 #define MARKDOWN_AST_H
 
 #include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+#include <QStringRef>
+#include <QVector>
 
 #include "markdownnode.h"
-#include "memoryarena.h"
 
 class cmark_node;
 
@@ -34,10 +37,14 @@ namespace ghostwriter
  * Use this class to clone a cmark_node AST and perform searches
  * on the tree.
  *
- * Note:  Due to cmark-gfm's memory arena used ot allocate cmark_node
- *        objects being non-reentrant, this class is used to clone
- *        a cmark_node AST to prevent node memory from being overwritten
- *        by another call to the cmark-gfm API.
+ * Note:  Since cmark-gfm's memory arena used to allocate cmark_node
+ *        objects is reset after each parse on the calling thread, this
+ *        class is used to clone a cmark_node AST to prevent node memory
+ *        from being overwritten by the next call to the cmark-gfm API.
+ *
+ *        The nodes are held in a single contiguous block of memory,
+ *        and their text is held as spans of the original Markdown text
+ *        where possible rather than as separate strings.
  */
 class MarkdownASTPrivate;
 class MarkdownAST
@@ -51,10 +58,20 @@ public:
     MarkdownAST();
 
     /**
-     * Constructor.  Clones the given cmark_node AST into a
-     * MarkdownNode AST.
+     * Constructor.  Clones the given cmark_node AST, which was parsed
+     * from the given Markdown text, into a MarkdownNode AST.  The column
+     * map of the text converts the node columns into positions within
+     * the text.  The node count hint, if greater than zero, is the
+     * expected number of nodes, so that storage for them can be
+     * allocated once up front.
      */
-    MarkdownAST(cmark_node *root);
+    MarkdownAST
+    (
+        cmark_node *root,
+        const QString &text,
+        const Utf8ColumnMap &columnMap,
+        int nodeCountHint = 0
+    );
 
     /**
      * Destructor.
@@ -64,22 +81,128 @@ public:
     /**
      * Returns the root node of the AST or nullptr if none is set.
      */
-    MarkdownNode *root();
+    MarkdownNode *root() const;
+
+    /**
+     * Sets the root node of the AST, cloning the given cmark_node AST,
+     * which was parsed from the given Markdown text, into a MarkdownNode
+     * AST.  Note that calling this routine will free the memory for the
+     * prior AST root node.  The column map of the text converts the node
+     * columns into positions within the text.  The node count hint, if
+     * greater than zero, is the expected number of nodes.
+     */
+    void setRoot
+    (
+        cmark_node *root,
+        const QString &text,
+        const Utf8ColumnMap &columnMap,
+        int nodeCountHint = 0
+    );
+
+    /**
+     * Returns a new AST that is a copy of this one, except that the
+     * top-level blocks spanning the given lines (inclusive) of the original
+     * Markdown text are replaced with copies of the top-level blocks in
+     * the given AST.  The given AST is expected to have been parsed from
+     * the slice of the new Markdown text beginning at firstLine, such that
+     * its line numbers are relative to that slice.  Blocks after the
+     * replaced lines have their line numbers shifted by lineDelta, which
+     * is the number of lines added to (or, if negative, removed from) the
+     * original Markdown text.  The new text is the whole of the Markdown
+     * text after the change.  The caller takes ownership of the new AST.
+     */
+    MarkdownAST *replaceBlocks
+    (
+        int firstLine,
+        int lastLine,
+        int lineDelta,
+        const MarkdownAST *blocks,
+        const QString &newText
+    ) const;
+
+    /**
+     * Returns a new AST whose top-level blocks are copies of those of
+     * the given ASTs, in order, each of which was parsed from a chunk of
+     * the given Markdown text.  The blocks of the AST at index i have
+     * their line numbers shifted by lineOffsets[i], and those starting
+     * before line firstLines[i] of their chunk are skipped.  The HTML of
+     * each block carries over if every AST had its blocks rendered
+     * separately.  The caller takes ownership of the new AST.
+     */
+    static MarkdownAST *join
+    (
+        const QVector<MarkdownAST *> &chunks,
+        const QVector<int> &firstLines,
+        const QVector<int> &lineOffsets,
+        const QString &text
+    );
+
+    /**
+     * Returns the number of nodes in this AST.  Use this count to give
+     * a node count hint when parsing a similar text.
+     */
+    int nodeCount() const;
+
+    /**
+     * Returns the text contained in the given node of this AST.  The
+     * returned reference remains valid for as long as this AST exists.
+     */
+    QStringRef text(const MarkdownNode *node) const;
+
+    /**
+     * Returns true if HTML was rendered from this AST.
+     */
+    bool hasHtml() const;
+
+    /**
+     * Returns the HTML rendered from this AST, or a null string if
+     * none was rendered.
+     */
+    QString html() const;
 
     /**
-     * Sets the root node of the AST, cloning the given cmark_node AST into
-     * a MarkdownNode AST.  Note that calling this routine will free the
-     * memory for the prior AST root node.
+     * Returns true if the HTML was rendered from each of the top-level
+     * blocks of this AST separately.
      */
-    void setRoot(cmark_node *root);
+    bool hasBlockHtml() const;
+
+    /**
+     * Returns the HTML rendered from each of the top-level blocks of this
+     * AST, in order, or an empty list if the blocks were not rendered
+     * separately.
+     */
+    QStringList blockHtml() const;
+
+    /**
+     * Sets the HTML rendered from each of the top-level blocks of this
+     * AST, in order.  Blocks rendered this way can be reused when
+     * the AST is copied by replaceBlocks().
+     */
+    void setBlockHtml(const QStringList &blockHtml);
+
+    /**
+     * Sets the HTML rendered from the whole AST, such as when its
+     * blocks cannot be rendered separately.
+     */
+    void setHtml(const QString &html);
 
     /**
      * Finds the deepest node of type block (vs. inline) at the given
      * line number of the original Markdown text.  Returns nullptr if
-     * no node is found at that location.
+     * no node is found at that location.  Lookups take logarithmic
+     * time in the number of blocks.
      */
     MarkdownNode *findBlockAtLine(int lineNumber) const;
 
+    /**
+     * Finds the deepest node of type block at each line in the given
+     * range of lines (inclusive) of the original Markdown text, in a
+     * single pass over the tree.  The node for line firstLine + i is
+     * at index i of the returned vector, and is the same as that
+     * returned by findBlockAtLine() for that line.
+     */
+    QVector<MarkdownNode *> findBlocksInLineRange(int firstLine, int lastLine) const;
+
     /**
      * Returns a list of all nodes that are of type heading, excluding
      * those that are nested within block quotes or lists.
@@ -21,11 +21,24 @@
 #include <QTextDocument>
 #include <QPlainTextDocumentLayout>
 #include <QFileInfo>
+#include <QList>
 
 #include "markdowndocument.h"
 
 namespace ghostwriter
 {
+/**
+ * An edit made to the text since the current AST snapshot was parsed.
+ */
+typedef struct TextEdit
+{
+    int revision;
+    int unchangedHeadLines;
+    int unchangedTailLines;
+    int lineCount;
+    int lineDelta;
+} TextEdit;
+
 class MarkdownDocumentPrivate
 {
     Q_DECLARE_PUBLIC(MarkdownDocument)
@@ -39,7 +52,11 @@ public:
     QString filePath;
     bool readOnlyFlag;
     QDateTime timestamp;
-    MarkdownAST *ast;
+    QSharedPointer<MarkdownAST> ast;
+    int astRevision;
+    int textRevision;
+    QList<TextEdit> pendingEdits;
+    bool htmlRenderingEnabled;
 
     MarkdownDocument *q_ptr;
 
@@ -54,6 +71,7 @@ MarkdownDocument::MarkdownDocument(QObject *parent)
 {
     Q_D(MarkdownDocument);
 
+    d->htmlRenderingEnabled = false;
     d->initializeUntitledDocument();
 }
 
@@ -62,6 +80,7 @@ MarkdownDocument::MarkdownDocument(const QString &text, QObject *parent)
 {
     Q_D(MarkdownDocument);
 
+    d->htmlRenderingEnabled = false;
     d->initializeUntitledDocument();
 }
 
@@ -73,10 +92,7 @@ MarkdownDocument::~MarkdownDocument()
         new QPlainTextDocumentLayout(this);
     this->setDocumentLayout(documentLayout);
 
-    if (nullptr != d->ast) {
-        delete d->ast;
-        d->ast = nullptr;
-    }
+    d->ast.clear();
 }
 
 QString MarkdownDocument::displayName() const
@@ -147,18 +163,124 @@ void MarkdownDocument::setTimestamp(const QDateTime &timestamp)
 }
 
 
-MarkdownAST *MarkdownDocument::markdownAST() const
+QSharedPointer<MarkdownAST> MarkdownDocument::markdownAST() const
 {
     Q_D(const MarkdownDocument);
 
     return d->ast;
 }
 
-void MarkdownDocument::setMarkdownAST(MarkdownAST *ast)
+int MarkdownDocument::markdownASTRevision() const
+{
+    Q_D(const MarkdownDocument);
+
+    return d->astRevision;
+}
+
+int MarkdownDocument::markdownASTLine(int line) const
+{
+    Q_D(const MarkdownDocument);
+
+    // Map the line back through each edit made since the snapshot
+    // was parsed, newest first.
+    //
+    for (int i = d->pendingEdits.size() - 1; i >= 0; i--) {
+        const TextEdit &edit = d->pendingEdits[i];
+
+        if (line <= edit.unchangedHeadLines) {
+            continue;
+        } else if (line > (edit.lineCount - edit.unchangedTailLines)) {
+            line -= edit.lineDelta;
+        } else {
+            return 0;
+        }
+    }
+
+    return line;
+}
+
+int MarkdownDocument::textRevision() const
+{
+    Q_D(const MarkdownDocument);
+
+    return d->textRevision;
+}
+
+int MarkdownDocument::markTextChanged
+(
+    int firstChangedLine,
+    int lastChangedLine,
+    int lineDelta
+)
 {
     Q_D(MarkdownDocument);
 
+    TextEdit edit;
+
+    d->textRevision++;
+    edit.revision = d->textRevision;
+    edit.lineCount = this->blockCount();
+    edit.lineDelta = lineDelta;
+    edit.unchangedHeadLines = qMax(firstChangedLine - 1, 0);
+    edit.unchangedTailLines = qMax(edit.lineCount - lastChangedLine, 0);
+    d->pendingEdits.append(edit);
+
+    return d->textRevision;
+}
+
+bool MarkdownDocument::htmlRenderingEnabled() const
+{
+    Q_D(const MarkdownDocument);
+
+    return d->htmlRenderingEnabled;
+}
+
+void MarkdownDocument::setHtmlRenderingEnabled(bool enabled)
+{
+    Q_D(MarkdownDocument);
+
+    if (enabled != d->htmlRenderingEnabled) {
+        d->htmlRenderingEnabled = enabled;
+        emit htmlRenderingEnabledChanged(enabled);
+    }
+}
+
+void MarkdownDocument::setMarkdownAST
+(
+    int revision,
+    QSharedPointer<MarkdownAST> ast,
+    const LineRangeSet &changedLines
+)
+{
+    Q_D(MarkdownDocument);
+
+    if (revision < d->astRevision) {
+        return;
+    }
+
     d->ast = ast;
+    d->astRevision = revision;
+
+    while (!d->pendingEdits.isEmpty() && (d->pendingEdits.first().revision <= revision)) {
+        d->pendingEdits.removeFirst();
+    }
+
+    // Map the changed lines forward through any edits made since the
+    // snapshot's revision.
+    //
+    LineRangeSet currentChangedLines = changedLines;
+
+    foreach (const TextEdit &edit, d->pendingEdits) {
+        currentChangedLines.applyEdit
+        (
+            edit.unchangedHeadLines,
+            edit.unchangedTailLines,
+            edit.lineCount,
+            edit.lineDelta
+        );
+    }
+
+    emit markdownASTChanged(currentChangedLines);
 }
 
 void MarkdownDocument::clear()
@@ -179,6 +301,9 @@ void MarkdownDocumentPrivate::initializeUntitledDocument()
     this->readOnlyFlag = false;
     this->displayName = QObject::tr("untitled");
     this->timestamp = QDateTime::currentDateTime();
-    this->ast = nullptr;
+    this->ast.clear();
+    this->astRevision = 0;
+    this->textRevision = 0;
+    this->pendingEdits.clear();
 }
 } // namespace ghostwriter
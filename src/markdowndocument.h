@@ -22,10 +22,12 @@
 
 #include <QDateTime>
 #include <QScopedPointer>
+#include <QSharedPointer>
 #include <QString>
 #include <QTextBlock>
 #include <QTextDocument>
 
+#include "linerangeset.h"
 #include "markdownast.h"
 
 namespace ghostwriter
@@ -99,14 +101,71 @@ public:
      */
     void setTimestamp(const QDateTime &timestamp);
 
-    MarkdownAST *markdownAST() const;
-    void setMarkdownAST(MarkdownAST *ast);
+    /**
+     * Returns the most recently parsed AST snapshot of the document's
+     * text, or a null pointer if the text has not yet been parsed.  The
+     * snapshot may lag behind the text while a newer revision is being
+     * parsed.  Use markdownASTLine() to find the line in the snapshot that
+     * corresponds to a line of the text.
+     */
+    QSharedPointer<MarkdownAST> markdownAST() const;
+
+    /**
+     * Returns the text revision from which the current AST snapshot
+     * was parsed.
+     */
+    int markdownASTRevision() const;
+
+    /**
+     * Returns the line number in the current AST snapshot that corresponds
+     * to the given line number of the document's text, or 0 if the line
+     * has been edited since the snapshot was parsed.
+     */
+    int markdownASTLine(int line) const;
+
+    /**
+     * Returns the current revision of the document's text.
+     */
+    int textRevision() const;
+
+    /**
+     * Records that the given lines (inclusive) of the document's text
+     * were edited, with lineDelta lines added (or, if negative, removed).
+     * Returns the new text revision.
+     */
+    int markTextChanged(int firstChangedLine, int lastChangedLine, int lineDelta);
+
+    /**
+     * Returns whether HTML is rendered into the AST snapshots of the
+     * document, such as for the HTML preview.
+     */
+    bool htmlRenderingEnabled() const;
+
+    /**
+     * Sets whether HTML is rendered into the AST snapshots of the
+     * document.
+     */
+    void setHtmlRenderingEnabled(bool enabled);
 
     /**
      * Overrides base class clear() method to send cleared() signal.
      */
     void clear();
 
+public slots:
+    /**
+     * Sets the AST snapshot parsed from the given revision of the
+     * document's text.  The changed lines are the lines in that revision
+     * whose nodes may differ from those of the prior snapshot.  Snapshots
+     * of revisions older than that of the current snapshot are discarded.
+     */
+    void setMarkdownAST
+    (
+        int revision,
+        QSharedPointer<MarkdownAST> ast,
+        const LineRangeSet &changedLines
+    );
+
 signals:
     /**
      * Emitted when the file path changes.
@@ -118,6 +177,19 @@ signals:
      */
     void cleared();
 
+    /**
+     * Emitted when a new AST snapshot is set.  The changed lines are the
+     * lines in the document's current text whose nodes may differ from
+     * those of the prior snapshot.
+     */
+    void markdownASTChanged(const LineRangeSet &changedLines);
+
+    /**
+     * Emitted when HTML rendering into the AST snapshots is enabled
+     * or disabled.
+     */
+    void htmlRenderingEnabledChanged(bool enabled);
+
 private:
     QScopedPointer<MarkdownDocumentPrivate> d_ptr;
 };
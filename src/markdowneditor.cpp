@@ -50,9 +50,10 @@
 #include <QString>
 #include <QTextCursor>
 
-#include "cmarkgfmapi.h"
+#include "backgroundspellchecker.h"
 #include "markdowneditor.h"
 #include "markdownhighlighter.h"
+#include "markdownparser.h"
 #include "markdownstates.h"
 #include "spelling/dictionary_manager.h"
 #include "spelling/dictionary_ref.h"
@@ -99,6 +100,13 @@ public:
     bool autoMatchEnabled;
     bool bulletPointCyclingEnabled;
     QList<QAction *> spellingActions;
+
+    // Time, in milliseconds, to wait for spelling suggestions to be found
+    // before showing the context menu without them.  The menu is updated
+    // with the suggestions once they are found.
+    //
+    static const int SpellingSuggestionsTimeout = 100;
+
     bool hemingwayModeEnabled;
     FocusMode focusMode;
     QBrush fadeColor;
@@ -116,6 +124,15 @@ public:
     QRegularExpression bulletListRegex;
     QRegularExpression taskListRegex;
 
+    // Parses the document on a background thread.
+    MarkdownParser *parser;
+
+    // The document's line count, revision, and number of undo steps
+    // as of the last parse request.
+    int parsedLineCount;
+    int parsedRevision;
+    int parsedUndoSteps;
+
     // Used for auto-insert and pairing.
     QHash<QChar, QChar> markupPairs;
 
@@ -147,7 +164,8 @@ public:
     bool typingPausedScaledSignalSent;
 
     void toggleCursorBlink();
-    void parseDocument();
+    bool isTextChange(int position, int charsRemoved, int charsAdded) const;
+    void parseDocument(int position, int charsRemoved, int charsAdded);
 
     void handleCarriageReturn();
     bool handleBackspaceKey();
@@ -157,6 +175,12 @@ public:
     bool handleEndPairCharacterTyped(const QChar ch);
     bool handleWhitespaceInEmptyMatch(const QChar whitespace);
     void insertFormattingMarkup(const QString &markup);
+    void insertSpellingSuggestions
+    (
+        QMenu *menu,
+        QAction *before,
+        const QStringList &suggestions
+    );
     QString priorIndentation();
     QString priorMarkdownBlockItemStart
     (
@@ -173,6 +197,8 @@ public:
     bool isCodeBlock(const QTextBlock &block) const;
 };
 
+const int MarkdownEditorPrivate::SpellingSuggestionsTimeout;
+
 MarkdownEditor::MarkdownEditor
 (
     MarkdownDocument *textDocument,
@@ -206,6 +232,9 @@ MarkdownEditor::MarkdownEditor
     d->emptyNumberedListRegex.setPattern("^\\s*([0-9]+)[.)]\\s+$");
     d->emptyBulletListRegex.setPattern("^\\s*[+*-]\\s+$");
     d->emptyTaskListRegex.setPattern("^\\s*[-*+] \\[([x ])\\]\\s+$");
+    d->parsedLineCount = 0;
+    d->parsedRevision = -1;
+    d->parsedUndoSteps = 0;
 
     this->setWordWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
     this->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -253,6 +282,27 @@ MarkdownEditor::MarkdownEditor
     d->nonEmptyMarkupPairs.insert('_', '_');
     d->nonEmptyMarkupPairs.insert('<', '>');
 
+    d->parser = new MarkdownParser(this);
+    connect(d->parser, &MarkdownParser::parsed, textDocument, &MarkdownDocument::setMarkdownAST);
+
+    // Copy the text for the parser only once it is ready to parse it,
+    // rather than on every change.
+    //
+    connect
+    (
+        d->parser,
+        &MarkdownParser::textRequested,
+        this,
+        [this, d]() {
+            MarkdownDocument *document = (MarkdownDocument *) this->document();
+            d->parser->setText(document->textRevision(), document->toPlainText());
+        },
+        Qt::QueuedConnection
+    );
+
+    connect(textDocument, &MarkdownDocument::htmlRenderingEnabledChanged, this, &MarkdownEditor::onHtmlRenderingEnabledChanged);
+    d->parser->setHtmlRenderingEnabled(textDocument->htmlRenderingEnabled());
+
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(onCursorPositionChanged()));
     connect(this->document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(onContentsChanged(int, int, int)));
     connect(this, SIGNAL(selectionChanged()), this, SLOT(onSelectionChanged()));
@@ -486,6 +536,25 @@ void MarkdownEditor::setDictionary(const QString &language)
     d->highlighter->setDictionary(d->dictionary);
 }
 
+void MarkdownEditor::visibleBlockRange(int &firstBlock, int &lastBlock) const
+{
+    QTextBlock block = firstVisibleBlock();
+    QPointF offset(contentOffset());
+    int viewportHeight = viewport()->height();
+
+    firstBlock = block.blockNumber();
+    lastBlock = firstBlock;
+
+    while (block.isValid()) {
+        if (blockBoundingGeometry(block).translated(offset).top() > viewportHeight) {
+            break;
+        }
+
+        lastBlock = block.blockNumber();
+        block = block.next();
+    }
+}
+
 QLayout *MarkdownEditor::preferredLayout()
 {
     Q_D(MarkdownEditor);
@@ -864,31 +933,45 @@ bool MarkdownEditor::eventFilter(QObject *watched, QEvent *event)
         );
 
         d->wordUnderMouse = d->cursorForWord.selectedText();
-        QStringList suggestions = d->dictionary.suggestions(d->wordUnderMouse);
+
         QMenu *popupMenu = createStandardContextMenu();
         QAction *firstAction = popupMenu->actions().first();
+        BackgroundSpellChecker *spellChecker = d->highlighter->spellChecker();
+        QStringList suggestions;
 
-        d->spellingActions.clear();
-
-        if (!suggestions.empty()) {
-            for (int i = 0; i < suggestions.size(); i++) {
-                QAction *suggestionAction = new QAction(suggestions[i], this);
+        bool suggestionsFound =
+            spellChecker->suggestions
+            (
+                d->wordUnderMouse,
+                suggestions,
+                MarkdownEditorPrivate::SpellingSuggestionsTimeout
+            );
 
-                // Need the following line because KDE Plasma 5 will insert a hidden ampersand
-                // into the menu text as a keyboard accelerator.  Go off of the data in the
-                // QAction rather than the text to avoid this.
-                //
-                suggestionAction->setData(suggestions[i]);
+        d->spellingActions.clear();
 
-                d->spellingActions.append(suggestionAction);
-                popupMenu->insertAction(firstAction, suggestionAction);
-            }
+        // Suggestions taking longer to find are added to the menu
+        // while it is open.
+        //
+        QAction *suggestionsStatusAction =
+            new QAction(tr("Finding spelling suggestions..."), this);
+        suggestionsStatusAction->setEnabled(false);
+        d->spellingActions.append(suggestionsStatusAction);
+        popupMenu->insertAction(firstAction, suggestionsStatusAction);
+
+        if (suggestionsFound) {
+            d->insertSpellingSuggestions(popupMenu, suggestionsStatusAction, suggestions);
         } else {
-            QAction *noSuggestionsAction =
-                new QAction(tr("No spelling suggestions found"), this);
-            noSuggestionsAction->setEnabled(false);
-            d->spellingActions.append(noSuggestionsAction);
-            popupMenu->insertAction(firstAction, noSuggestionsAction);
+            connect
+            (
+                spellChecker,
+                &BackgroundSpellChecker::suggestionsReady,
+                popupMenu,
+                [d, popupMenu, suggestionsStatusAction](const QString &word, const QStringList &suggestions) {
+                    if (word == d->wordUnderMouse) {
+                        d->insertSpellingSuggestions(popupMenu, suggestionsStatusAction, suggestions);
+                    }
+                }
+            );
         }
 
         popupMenu->insertSeparator(firstAction);
@@ -1449,11 +1532,7 @@ void MarkdownEditor::runSpellChecker()
 {
     Q_D(MarkdownEditor);
     
-    if (d->spellCheckEnabled) {
-        SpellChecker::checkDocument(this, d->highlighter, d->dictionary);
-    } else {
-        SpellChecker::checkDocument(this, nullptr, d->dictionary);
-    }
+    SpellChecker::checkDocument(this, d->dictionary, d->highlighter->spellChecker());
 }
 
 void MarkdownEditor::setSpellCheckEnabled(const bool enabled)
@@ -1493,24 +1572,24 @@ void MarkdownEditor::suggestSpelling(QAction *action)
     if (action == d->addWordToDictionaryAction) {
         this->setTextCursor(d->cursorForWord);
         d->dictionary.addToPersonal(d->wordUnderMouse);
-        d->highlighter->rehighlight();
     } else if (action == d->checkSpellingAction) {
         this->setTextCursor(d->cursorForWord);
-        SpellChecker::checkDocument(this, d->highlighter, d->dictionary);
+        SpellChecker::checkDocument(this, d->dictionary, d->highlighter->spellChecker());
     } else if (d->spellingActions.contains(action)) {
         d->cursorForWord.insertText(action->data().toString());
     }
 }
 
-void MarkdownEditor::onContentsChanged(int position, int charsAdded, int charsRemoved)
+void MarkdownEditor::onContentsChanged(int position, int charsRemoved, int charsAdded)
 {
     Q_D(MarkdownEditor);
-    
-    Q_UNUSED(position)
-    Q_UNUSED(charsAdded)
-    Q_UNUSED(charsRemoved)
 
-    d->parseDocument();
+    // Ignore formatting changes made by the highlighter.
+    if (!d->isTextChange(position, charsRemoved, charsAdded)) {
+        return;
+    }
+
+    d->parseDocument(position, charsRemoved, charsAdded);
 
     // Don't use the textChanged() or contentsChanged() (no parameters) signals
     // for checking if the typingResumed() signal needs to be emitted.  These
@@ -1533,12 +1612,7 @@ void MarkdownEditor::onSelectionChanged()
     QTextCursor cursor = this->textCursor();
 
     if (cursor.hasSelection()) {
-        emit textSelected
-        (
-            cursor.selectedText(),
-            cursor.selectionStart(),
-            cursor.selectionEnd()
-        );
+        emit textSelected(cursor.selectionStart(), cursor.selectionEnd());
     } else {
         emit textDeselected();
     }
@@ -1685,7 +1759,7 @@ void MarkdownEditor::spellCheckFinished(int result)
     Q_UNUSED(result)
     Q_D(MarkdownEditor);
     
-    d->highlighter->rehighlight();
+    d->highlighter->scheduleRehighlight();
 }
 
 void MarkdownEditor::onCursorPositionChanged()
@@ -1720,6 +1794,20 @@ void MarkdownEditor::onCursorPositionChanged()
     emit cursorPositionChanged(this->textCursor().position());
 }
 
+void MarkdownEditor::onHtmlRenderingEnabledChanged(bool enabled)
+{
+    Q_D(MarkdownEditor);
+
+    d->parser->setHtmlRenderingEnabled(enabled);
+
+    // Re-parse the unchanged text so that its AST snapshot includes
+    // the rendered HTML.
+    //
+    if (enabled) {
+        d->parser->requestReparse();
+    }
+}
+
 void MarkdownEditorPrivate::toggleCursorBlink()
 {
     Q_Q(MarkdownEditor);
@@ -1728,21 +1816,81 @@ void MarkdownEditorPrivate::toggleCursorBlink()
     q->update();
 }
 
-void MarkdownEditorPrivate::parseDocument()
+bool MarkdownEditorPrivate::isTextChange
+(
+    int position,
+    int charsRemoved,
+    int charsAdded
+) const
 {
-    Q_Q(MarkdownEditor);
-    
-    MarkdownAST *ast =
-        CmarkGfmAPI::instance()->parse
-        (
-            q->document()->toPlainText(),
-            false
-        );
+    Q_Q(const MarkdownEditor);
+
+    QTextDocument *document = q->document();
+
+    if
+    (
+        (charsRemoved != charsAdded)
+        || (document->blockCount() != parsedLineCount)
+        || (document->availableUndoSteps() != parsedUndoSteps)
+    ) {
+        return true;
+    }
 
-    // Note:  MarkdownDocument is responsible for freeing memory
-    // allocated for the AST.
+    // QSyntaxHighlighter reports its formatting changes as though the
+    // formatted text were replaced with itself.  Text edits, however,
+    // stamp each block they touch with the document's current revision.
     //
-    ((MarkdownDocument *) q->document())->setMarkdownAST(ast);
+    QTextBlock block = document->findBlock(position);
+    QTextBlock lastBlock = document->findBlock(position + charsAdded);
+
+    while (block.isValid()) {
+        if (block.revision() > parsedRevision) {
+            return true;
+        }
+
+        if (block == lastBlock) {
+            break;
+        }
+
+        block = block.next();
+    }
+
+    return false;
+}
+
+void MarkdownEditorPrivate::parseDocument
+(
+    int position,
+    int charsRemoved,
+    int charsAdded
+)
+{
+    Q_Q(MarkdownEditor);
+    Q_UNUSED(charsRemoved)
+
+    MarkdownDocument *document = (MarkdownDocument *) q->document();
+    int lineCount = document->blockCount();
+    int firstLine = 1;
+    int lastLine = lineCount;
+
+    QTextBlock block = document->findBlock(position);
+
+    if (block.isValid()) {
+        firstLine = block.blockNumber() + 1;
+    }
+
+    block = document->findBlock(position + charsAdded);
+
+    if (block.isValid()) {
+        lastLine = block.blockNumber() + 1;
+    }
+
+    document->markTextChanged(firstLine, lastLine, lineCount - parsedLineCount);
+    parser->requestParse(firstLine, lastLine, lineCount);
+
+    parsedLineCount = lineCount;
+    parsedRevision = document->revision();
+    parsedUndoSteps = document->availableUndoSteps();
 }
 
 void MarkdownEditorPrivate::handleCarriageReturn()
@@ -2129,6 +2277,36 @@ bool MarkdownEditorPrivate::handleWhitespaceInEmptyMatch(const QChar whitespace)
     return false;
 }
 
+void MarkdownEditorPrivate::insertSpellingSuggestions
+(
+    QMenu *menu,
+    QAction *before,
+    const QStringList &suggestions
+)
+{
+    Q_Q(MarkdownEditor);
+
+    if (suggestions.isEmpty()) {
+        before->setText(MarkdownEditor::tr("No spelling suggestions found"));
+        return;
+    }
+
+    for (int i = 0; i < suggestions.size(); i++) {
+        QAction *suggestionAction = new QAction(suggestions[i], q);
+
+        // Need the following line because KDE Plasma 5 will insert a hidden ampersand
+        // into the menu text as a keyboard accelerator.  Go off of the data in the
+        // QAction rather than the text to avoid this.
+        //
+        suggestionAction->setData(suggestions[i]);
+
+        spellingActions.append(suggestionAction);
+        menu->insertAction(before, suggestionAction);
+    }
+
+    before->setVisible(false);
+}
+
 void MarkdownEditorPrivate::insertFormattingMarkup(const QString &markup)
 {
     Q_Q(MarkdownEditor);
@@ -80,6 +80,12 @@ public:
      */
     QLayout *preferredLayout();
 
+    /**
+     * Gets the numbers of the first and last (inclusive) text blocks
+     * that are at least partially visible in the viewport.
+     */
+    void visibleBlockRange(int &firstBlock, int &lastBlock) const;
+
     /**
      * Gets whether Hemingway mode is enabled.
      */
@@ -176,16 +182,11 @@ signals:
     void cursorPositionChanged(int position);
 
     /**
-     * Emitted when the user selects text.  The selected text, as
-     * well as the cursor position of the beginning and end of the
-     * selection in the document, are provided as parameters.
+     * Emitted when the user selects text.  The cursor position of the
+     * beginning and end of the selection in the document are provided
+     * as parameters.
      */
-    void textSelected
-    (
-        const QString &selectedText,
-        int selectionStart,
-        int selectionEnd
-    );
+    void textSelected(int selectionStart, int selectionEnd);
 
     /**
      * Emitted when the user deselects text (i.e., no text is currently
@@ -364,13 +365,14 @@ public slots:
 
 protected slots:
     void suggestSpelling(QAction *action);
-    void onContentsChanged(int position, int charsAdded, int charsRemoved);
+    void onContentsChanged(int position, int charsRemoved, int charsAdded);
     void onSelectionChanged();
     void focusText();
     void checkIfTypingPaused();
     void checkIfTypingPausedScaled();
     void spellCheckFinished(int result);
     void onCursorPositionChanged();
+    void onHtmlRenderingEnabledChanged(bool enabled);
 
 private:
     QScopedPointer<MarkdownEditorPrivate> d_ptr;
@@ -20,7 +20,9 @@
 #include <QBrush>
 #include <QColor>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFont>
+#include <QHash>
 #include <QObject>
 #include <QPainter>
 #include <QRegularExpression>
@@ -35,11 +37,16 @@
 #include <QApplication>
 #include <Qt>
 #include <QTextLayout>
+#include <QTimer>
+#include <QVariant>
+#include <QVarLengthArray>
+#include <QSharedPointer>
 #include <QStack>
+#include <QVector>
 
 #include "markdownhighlighter.h"
 #include "markdownstates.h"
-#include "spelling/dictionary_ref.h"
+#include "backgroundspellchecker.h"
 #include "spelling/dictionary_manager.h"
 
 namespace ghostwriter
@@ -52,11 +59,22 @@ class MarkdownHighlighterPrivate
 public:
     MarkdownHighlighterPrivate(MarkdownHighlighter *highlighter) :
         q_ptr(highlighter),
-        dictionary(DictionaryManager::instance().requestDictionary()),
+        blockCacheFirstLine(0),
+        blockCacheBatchSize(1),
+        rehighlightTimer(nullptr),
+        nextBlockToRehighlight(0),
+        blocksLeftToRehighlight(0),
+        rehighlightBlockCount(0),
+        sweepMode(RehighlightSweep),
+        blockUpdateMode(RehighlightSweep),
+        fontPointSize(12.0),
+        spellChecker(nullptr),
         inBlockquote(false),
         spellCheckEnabled(false),
         typingPaused(true),
-        useUndlerlineForEmphasis(false)
+        useLargeHeadings(false),
+        useUndlerlineForEmphasis(false),
+        italicizeBlockquotes(false)
     {
         ;
     }
@@ -66,12 +84,119 @@ public:
         ;
     }
 
+    // Maximum number of lines whose blocks are looked up in one batch.
+    static const int MaxBlockCacheBatchSize = 1024;
+
+    // Maximum time spent rehighlighting blocks in each slice of a
+    // scheduled rehighlight before returning to the event loop.
+    //
+    static const int RehighlightSliceMsecs = 15;
+
+    // Character formats are interned by a key that combines a color role
+    // (in the lowest byte) with flags for the Markdown semantics of the
+    // text and its heading level, so that each distinct format is built
+    // once per color scheme or font change and then shared by every block
+    // that uses it.  The key describes what the text is rather than how
+    // it looks.  Which colors, font styles and heading sizes it maps to
+    // is decided when the format is built, from the current settings.
+    //
+    // The font family and size are left as the document's, so that they
+    // change with the editor's font without touching the formats.
+    //
+    typedef quint32 FormatKey;
+
+    enum ColorRole
+    {
+        ForegroundRole,
+        BlockquoteMarkupRole,
+        BlockquoteTextRole,
+        HeadingMarkupRole,
+        HeadingTextRole,
+        CodeMarkupRole,
+        CodeTextRole,
+        ListMarkupRole,
+        EmphasisMarkupRole,
+        EmphasisTextRole,
+        InlineHtmlRole,
+        LinkRole,
+        ImageRole,
+        DividerRole,
+        TransparentRole,
+        ColorRoleMask = 0xFF
+    };
+
+    enum FormatFlag
+    {
+        BoldFlag = 0x100,
+        EmphasisTextFlag = 0x200,
+        EmphasisMarkupFlag = 0x400,
+        StrikeOutFlag = 0x800,
+        SpellingErrorFlag = 0x1000,
+        BlockquoteFlag = 0x2000
+    };
+
+    static const int HeadingLevelShift = 16;
+    static const FormatKey HeadingLevelMask = 0xFF0000;
+
+    // Each format holds its key in this property, so that blocks can be
+    // restyled from the formats they already have.
+    //
+    static const int FormatKeyProperty = QTextFormat::UserProperty;
+
+    // Sweep modes are ordered by how much of each block they update, each
+    // doing all that those before it do.
+    //
+    enum SweepMode
+    {
+        // Rebuild each block's formats from the keys they hold, such as
+        // when only the colors or the font have changed.
+        //
+        RestyleSweep,
+
+        // Rebuild each block's formats from the keys they hold, with
+        // spelling errors marked anew.
+        //
+        RespellSweep,
+
+        // Highlight each block anew from the AST.
+        RehighlightSweep
+    };
+
     MarkdownHighlighter *const q_ptr;
 
+    // AST of the block being highlighted, for which the blocks at the
+    // lines from blockCacheFirstLine onward are cached.
+    //
+    QSharedPointer<MarkdownAST> ast;
+    QVector<MarkdownNode *> blockCache;
+    int blockCacheFirstLine;
+    int blockCacheBatchSize;
+
+    // A scheduled rehighlight sweeps the blocks that remain after the
+    // visible blocks have been highlighted, wrapping around from the
+    // last block of the document to the first.
+    //
+    QTimer *rehighlightTimer;
+    int nextBlockToRehighlight;
+    int blocksLeftToRehighlight;
+    int rehighlightBlockCount;
+    SweepMode sweepMode;
+
+    // How the block passed to highlightBlock() is to be updated.
+    SweepMode blockUpdateMode;
+
     ColorScheme colors;
     QTextBlock currentLine;
-    QTextCharFormat defaultFormat;
-    DictionaryRef dictionary;
+    qreal fontPointSize;
+    QHash<FormatKey, QTextCharFormat> formatCache;
+
+    // Format key of each character of the block being highlighted.  The
+    // formats are applied in runs once the whole block is highlighted.
+    // The storage is reused from block to block.
+    //
+    QVector<FormatKey> lineFormats;
+
+    BackgroundSpellChecker *spellChecker;
     MarkdownEditor *editor;
     QRegularExpression heading1SetextRegex;
     QRegularExpression heading2SetextRegex;
@@ -84,15 +209,37 @@ public:
     bool useUndlerlineForEmphasis;
     bool italicizeBlockquotes;
 
-    bool isSetextHeadingState(const int state);
+    MarkdownNode *blockAtLine(const QSharedPointer<MarkdownAST> &ast, const int line);
     bool lineMatchesNode(const int line, const MarkdownNode *const node) const;
     int columnInLine(const MarkdownNode *const node, const QString &lineText) const;
-    void applyFormattingForNode(const MarkdownNode *const node);
-    void highlightRefLinks(const int pos, const int length);
+    void applyFormattingForNode(const MarkdownNode *const node, const QString &text, const int line);
+
+    static FormatKey withColor(const FormatKey key, const ColorRole role);
+    static FormatKey withFlag(const FormatKey key, const FormatFlag flag, const bool enabled = true);
+    static FormatKey withHeadingLevel(const FormatKey key, const int level);
+    QColor color(const ColorRole role) const;
+    const QTextCharFormat &internedFormat(const FormatKey key);
+    void setLineFormat(int start, int length, const FormatKey key);
+    void applyLineFormats();
+    void restyleCurrentBlock();
+    void respellCurrentBlock(const QString &text);
+    void scheduleSweep(SweepMode mode);
+    void scheduleRestyle();
+    void updateBlock(const QTextBlock &block, const SweepMode mode);
+    bool isRehighlightPending(const int blockNumber) const;
+    void rehighlightVisibleBlocks();
+    void rehighlightNextSlice();
+    void onBlockCountChanged(const int newBlockCount);
+    void highlightRefLinks(const QString &text, const int pos, const int length);
     void setupHeadingFontSize(bool useLargeHeadings);
     void spellCheck(const QString &text);
 };
 
+const int MarkdownHighlighterPrivate::MaxBlockCacheBatchSize;
+const int MarkdownHighlighterPrivate::HeadingLevelShift;
+const MarkdownHighlighterPrivate::FormatKey MarkdownHighlighterPrivate::HeadingLevelMask;
+const int MarkdownHighlighterPrivate::FormatKeyProperty;
+
 MarkdownHighlighter::MarkdownHighlighter
 (
     MarkdownEditor *editor,
@@ -120,21 +267,90 @@ MarkdownHighlighter::MarkdownHighlighter
 
     connect
     (
+        (MarkdownDocument *) editor->document(),
+        &MarkdownDocument::markdownASTChanged,
         this,
-        SIGNAL(highlightBlockAtPosition(int)),
+        &MarkdownHighlighter::onMarkdownASTChanged
+    );
+
+    d->rehighlightTimer = new QTimer(this);
+    d->rehighlightTimer->setSingleShot(true);
+    d->rehighlightTimer->setInterval(0);
+
+    connect
+    (
+        d->rehighlightTimer,
+        &QTimer::timeout,
         this,
-        SLOT(onHighlightBlockAtPosition(int)),
-        Qt::QueuedConnection
+        [d]() {
+            d->rehighlightNextSlice();
+        }
     );
 
-    QFont font;
-    font.setFamily("Monospace");
-    font.setWeight(QFont::Normal);
-    font.setItalic(false);
-    font.setPointSizeF(12.0);
-    font.setStyleStrategy(QFont::PreferAntialias);
-    d->defaultFormat.setFont(font);
-    d->defaultFormat.setForeground(QBrush(d->colors.foreground));
+    // Blocks that scroll into view ahead of a scheduled rehighlight
+    // are highlighted before those that remain out of view.
+    //
+    connect
+    (
+        editor,
+        &QPlainTextEdit::updateRequest,
+        this,
+        [d](const QRect &rect, int dy) {
+            Q_UNUSED(rect)
+
+            if ((0 != dy) && (d->blocksLeftToRehighlight > 0)) {
+                d->rehighlightVisibleBlocks();
+            }
+        }
+    );
+
+    connect
+    (
+        editor->document(),
+        &QTextDocument::blockCountChanged,
+        this,
+        [d](int newBlockCount) {
+            d->onBlockCountChanged(newBlockCount);
+        }
+    );
+
+    d->spellChecker =
+        new BackgroundSpellChecker
+        (
+            DictionaryManager::instance().requestDictionary(),
+            this
+        );
+
+    // Only the spelling errors of a block are updated when the results
+    // of checking it arrive.
+    //
+    connect
+    (
+        d->spellChecker,
+        &BackgroundSpellChecker::blocksChecked,
+        this,
+        [d](const QVector<QTextBlock> &blocks) {
+            if (d->spellCheckEnabled) {
+                foreach (const QTextBlock &block, blocks) {
+                    if (block.isValid()) {
+                        d->updateBlock(block, MarkdownHighlighterPrivate::RespellSweep);
+                    }
+                }
+            }
+        }
+    );
+
+    connect
+    (
+        d->spellChecker,
+        &BackgroundSpellChecker::invalidated,
+        this,
+        [d]() {
+            if (d->spellCheckEnabled) {
+                d->scheduleSweep(MarkdownHighlighterPrivate::RespellSweep);
+            }
+        }
+    );
 }
 
 MarkdownHighlighter::~MarkdownHighlighter()
@@ -159,33 +375,50 @@ void MarkdownHighlighter::highlightBlock(const QString &text)
 {
     Q_D(MarkdownHighlighter);
 
-    int line = currentBlock().blockNumber() + 1;
-    int oldState = currentBlock().userState();
+    // Keep the block's formatting (and state) when only its styling
+    // or its spelling errors have changed.
+    //
+    switch (d->blockUpdateMode) {
+    case MarkdownHighlighterPrivate::RestyleSweep:
+        d->restyleCurrentBlock();
+        return;
+    case MarkdownHighlighterPrivate::RespellSweep:
+        d->respellCurrentBlock(text);
+        return;
+    default:
+        break;
+    }
+
+    MarkdownDocument *document = (MarkdownDocument *) this->document();
+    int line = document->markdownASTLine(currentBlock().blockNumber() + 1);
 
-    MarkdownAST *ast = ((MarkdownDocument *) this->document())->markdownAST();
+    QSharedPointer<MarkdownAST> ast = document->markdownAST();
     MarkdownNode *node = nullptr;
 
-    if (nullptr != ast) {
-        node = ast->findBlockAtLine(line);
+    if (!ast.isNull()) {
+        // If the line was edited since the AST was parsed, keep its
+        // current formatting (and state) until the next AST arrives.
+        //
+        if (line <= 0) {
+            d->restyleCurrentBlock();
+            return;
+        }
+
+        node = d->blockAtLine(ast, line);
     }
 
+    d->lineFormats.fill(MarkdownHighlighterPrivate::ForegroundRole, text.length());
+
     if ((nullptr != node) && (MarkdownNode::Invalid != node->type())) {
-        d->applyFormattingForNode(node);
+        d->applyFormattingForNode(node, text, line);
     } else {
-        setFormat(0, currentBlock().length(), d->colors.foreground);
-
-        if (currentBlock().text().trimmed().isEmpty()) {
+        if (text.trimmed().isEmpty()) {
             setCurrentBlockState(MarkdownStateParagraphBreak);
-        } else if (d->referenceDefinitionRegex.match(currentBlock().text()).hasMatch()) {
-            QTextCharFormat format = d->defaultFormat;
-            format.setForeground(d->colors.link);
-
-            setFormat(0, currentBlock().text().indexOf(':'), format);
+        } else if (d->referenceDefinitionRegex.match(text).hasMatch()) {
+            d->setLineFormat(0, text.indexOf(':'), MarkdownHighlighterPrivate::LinkRole);
             setCurrentBlockState(MarkdownStateParagraph);
-        } else if (d->inlineHtmlCommentRegex.match(currentBlock().text()).hasMatch()) {
-            QTextCharFormat format = d->defaultFormat;
-            format.setForeground(d->colors.inlineHtml);
-            setFormat(0, currentBlock().text().length(), format);
+        } else if (d->inlineHtmlCommentRegex.match(text).hasMatch()) {
+            d->setLineFormat(0, text.length(), MarkdownHighlighterPrivate::InlineHtmlRole);
 
             if (previousBlockState() != MarkdownStateUnknown) {
                 setCurrentBlockState(previousBlockState());
@@ -195,88 +428,78 @@ void MarkdownHighlighter::highlightBlock(const QString &text)
         }
     }
 
-    if (d->isSetextHeadingState(oldState) && !d->isSetextHeadingState(currentBlockState())) {
-        QTextBlock block = currentBlock();
-
-        while
-        (
-            block.previous().isValid()
-            && (d->isSetextHeadingState(block.previous().userState()))
-        ) {
-            block = block.previous();
-        }
+    // Make whitespace transparent, so that underlines and strikeouts
+    // don't extend between words.
+    //
+    for (int i = 0; i < text.length(); i++) {
+        ushort c = text[i].unicode();
 
-        if (currentBlock() != block) {
-            emit highlightBlockAtPosition(block.position());
+        if ((' ' == c) || (('\t' <= c) && ('\r' >= c))) {
+            d->lineFormats[i] =
+                MarkdownHighlighterPrivate::withColor
+                (
+                    d->lineFormats[i],
+                    MarkdownHighlighterPrivate::TransparentRole
+                );
         }
-    } else if
-    (
-        currentBlock().previous().isValid()
-        &&
-        (
-            (
-                (MarkdownStatePipeTableDivider == (oldState & MarkdownStateMask))
-                && (MarkdownStatePipeTableDivider != (currentBlockState() & MarkdownStateMask))
-            )
-            ||
-            (
-                (MarkdownStatePipeTableDivider != (oldState & MarkdownStateMask))
-                && (MarkdownStatePipeTableDivider == (currentBlockState() & MarkdownStateMask))
-            )
-        )
-    ) {
-        emit highlightBlockAtPosition(currentBlock().previous().position());
     }
 
     // Highlight last two spaces of the line to indicate line breaks.
-    //
-    QRegularExpression whitespaceRegex("(\\s+)");
-    QRegularExpressionMatchIterator matchIter = whitespaceRegex.globalMatch(currentBlock().text());
-
-    while (matchIter.hasNext()) {
-        QRegularExpressionMatch match = matchIter.next();
-        QTextCharFormat format = this->format(match.capturedStart());
-
-        format.setForeground(Qt::transparent);
-        this->setFormat(match.capturedStart(), match.capturedLength(), format);
-    }
-
-    if (currentBlock().text().endsWith("  ")) {
-        QTextCharFormat format = this->format(currentBlock().text().length() - 2);
-        format.setForeground(d->colors.listMarkup);
-        this->setFormat(currentBlock().text().length() - 2, 2, format);
+    if (text.endsWith("  ")) {
+        for (int i = text.length() - 2; i < text.length(); i++) {
+            d->lineFormats[i] =
+                MarkdownHighlighterPrivate::withColor
+                (
+                    d->lineFormats[i],
+                    MarkdownHighlighterPrivate::ListMarkupRole
+                );
+        }
     }
 
     if (d->spellCheckEnabled) {
         d->spellCheck(text);
     }
+
+    d->applyLineFormats();
+}
+
+BackgroundSpellChecker *MarkdownHighlighter::spellChecker() const
+{
+    Q_D(const MarkdownHighlighter);
+
+    return d->spellChecker;
 }
 
 void MarkdownHighlighter::setDictionary(const DictionaryRef &dictionary)
 {
     Q_D(MarkdownHighlighter);
 
-    d->dictionary = dictionary;
-
-    if (d->spellCheckEnabled) {
-        rehighlight();
-    }
+    // Blocks are respelled once the spell checker signals that its
+    // results are out of date.
+    d->spellChecker->setDictionary(dictionary);
 }
 
 void MarkdownHighlighter::increaseFontSize()
 {
     Q_D(MarkdownHighlighter);
 
-    d->defaultFormat.setFontPointSize(d->defaultFormat.fontPointSize() + 1.0);
-    rehighlight();
+    d->fontPointSize += 1.0;
+
+    // Only large headings are sized apart from the document's font.
+    if (d->useLargeHeadings) {
+        d->scheduleRestyle();
+    }
 }
 
 void MarkdownHighlighter::decreaseFontSize()
 {
     Q_D(MarkdownHighlighter);
     
-    d->defaultFormat.setFontPointSize(d->defaultFormat.fontPointSize() - 1.0);
-    rehighlight();
+    d->fontPointSize -= 1.0;
+
+    if (d->useLargeHeadings) {
+        d->scheduleRestyle();
+    }
 }
 
 void MarkdownHighlighter::setColorScheme(const ColorScheme &colors)
@@ -284,46 +507,55 @@ void MarkdownHighlighter::setColorScheme(const ColorScheme &colors)
     Q_D(MarkdownHighlighter);
     
     d->colors = colors;
-    d->defaultFormat.setForeground(QBrush(colors.foreground));
-    rehighlight();
+    d->scheduleRestyle();
 }
 
 void MarkdownHighlighter::setEnableLargeHeadingSizes(const bool enable)
 {
     Q_D(MarkdownHighlighter);
     
-    d->useLargeHeadings = enable;
-    rehighlight();
+    if (enable != d->useLargeHeadings) {
+        d->useLargeHeadings = enable;
+        d->scheduleRestyle();
+    }
 }
 
 void MarkdownHighlighter::setUseUnderlineForEmphasis(const bool enable)
 {
     Q_D(MarkdownHighlighter);
     
-    d->useUndlerlineForEmphasis = enable;
-    rehighlight();
+    if (enable != d->useUndlerlineForEmphasis) {
+        d->useUndlerlineForEmphasis = enable;
+        d->scheduleRestyle();
+    }
 }
 
 void MarkdownHighlighter::setItalicizeBlockquotes(const bool enable)
 {
     Q_D(MarkdownHighlighter);
     
-    d->italicizeBlockquotes = enable;
-    rehighlight();
+    if (enable != d->italicizeBlockquotes) {
+        d->italicizeBlockquotes = enable;
+        d->scheduleRestyle();
+    }
 }
 
 void MarkdownHighlighter::setFont(const QString &fontFamily, const double fontSize)
 {
     Q_D(MarkdownHighlighter);
-    
-    QFont font;
-    font.setFamily(fontFamily);
-    font.setWeight(QFont::Normal);
-    font.setItalic(false);
-    font.setPointSizeF(fontSize);
-    d->defaultFormat.setFont(font);
+    Q_UNUSED(fontFamily)
+
+    // The formats take their font family and size from the document,
+    // which the editor sets along with this font.  Only large headings
+    // need to be restyled for a new size.
+    //
+    if (fontSize != d->fontPointSize) {
+        d->fontPointSize = fontSize;
 
-    rehighlight();
+        if (d->useLargeHeadings) {
+            d->scheduleRestyle();
+        }
+    }
 }
 
 void MarkdownHighlighter::setSpellCheckEnabled(const bool enabled)
@@ -331,7 +563,14 @@ void MarkdownHighlighter::setSpellCheckEnabled(const bool enabled)
     Q_D(MarkdownHighlighter);
     
     d->spellCheckEnabled = enabled;
-    rehighlight();
+    d->scheduleSweep(MarkdownHighlighterPrivate::RespellSweep);
+}
+
+void MarkdownHighlighter::scheduleRehighlight()
+{
+    Q_D(MarkdownHighlighter);
+
+    d->scheduleSweep(MarkdownHighlighterPrivate::RehighlightSweep);
 }
 
 void MarkdownHighlighter::onTypingResumed()
@@ -349,7 +588,7 @@ void MarkdownHighlighter::onTypingPaused()
 
     if (d->spellCheckEnabled) {
         QTextBlock block = document()->findBlock(d->editor->textCursor().position());
-        rehighlightBlock(block);
+        d->updateBlock(block, MarkdownHighlighterPrivate::RespellSweep);
     }
 }
 
@@ -362,16 +601,179 @@ void MarkdownHighlighter::onCursorPositionChanged()
         d->spellCheckEnabled &&
         (d->currentLine != d->editor->textCursor().block())
     ) {
-        rehighlightBlock(d->currentLine);
+        d->updateBlock(d->currentLine, MarkdownHighlighterPrivate::RespellSweep);
     }
 
     d->currentLine = d->editor->textCursor().block();
 }
 
-void MarkdownHighlighter::onHighlightBlockAtPosition(int position)
-{    
-    QTextBlock block = document()->findBlock(position);
-    rehighlightBlock(block);
+void MarkdownHighlighter::onMarkdownASTChanged(const LineRangeSet &changedLines)
+{
+    QTextBlock block;
+
+    for (int i = 0; i < changedLines.rangeCount(); i++) {
+        const LineRangeSet::LineRange &range = changedLines.rangeAt(i);
+
+        // Walk forward from the prior range rather than looking up
+        // each range's first block anew, unless the range is far off.
+        //
+        if (!block.isValid() || ((range.firstLine - 1 - block.blockNumber()) > 64)) {
+            block = document()->findBlockByNumber(range.firstLine - 1);
+        } else {
+            while (block.isValid() && (block.blockNumber() < (range.firstLine - 1))) {
+                block = block.next();
+            }
+        }
+
+        for (int line = range.firstLine; block.isValid() && (line <= range.lastLine); line++) {
+            rehighlightBlock(block);
+            block = block.next();
+        }
+    }
+}
+
+void MarkdownHighlighterPrivate::scheduleSweep(SweepMode mode)
+{
+    Q_Q(MarkdownHighlighter);
+
+    // Blocks already swept by a sweep in progress that does more work
+    // than the one requested would be left out of date by the lesser
+    // sweep, so the greater sweep must start over instead.
+    //
+    if ((blocksLeftToRehighlight > 0) && (sweepMode > mode)) {
+        mode = sweepMode;
+    }
+
+    int firstVisibleBlock;
+    int lastVisibleBlock;
+
+    editor->visibleBlockRange(firstVisibleBlock, lastVisibleBlock);
+
+    if (firstVisibleBlock < 0) {
+        firstVisibleBlock = 0;
+        lastVisibleBlock = -1;
+    }
+
+    // Supersede any rehighlight still in progress with a sweep of the
+    // blocks that follow the visible ones.
+    //
+    sweepMode = mode;
+    rehighlightBlockCount = q->document()->blockCount();
+    nextBlockToRehighlight = firstVisibleBlock;
+    blocksLeftToRehighlight = rehighlightBlockCount;
+    rehighlightVisibleBlocks();
+
+    if (blocksLeftToRehighlight > 0) {
+        rehighlightTimer->start();
+    } else {
+        rehighlightTimer->stop();
+    }
+}
+
+void MarkdownHighlighterPrivate::scheduleRestyle()
+{
+    formatCache.clear();
+    scheduleSweep(RestyleSweep);
+}
+
+void MarkdownHighlighterPrivate::updateBlock(const QTextBlock &block, const SweepMode mode)
+{
+    Q_Q(MarkdownHighlighter);
+
+    blockUpdateMode = mode;
+    q->rehighlightBlock(block);
+    blockUpdateMode = RehighlightSweep;
+}
+
+bool MarkdownHighlighterPrivate::isRehighlightPending(const int blockNumber) const
+{
+    if ((blockNumber < 0) || (rehighlightBlockCount <= 0)) {
+        return false;
+    }
+
+    int distance =
+        (blockNumber - nextBlockToRehighlight + rehighlightBlockCount)
+        % rehighlightBlockCount;
+
+    return distance < blocksLeftToRehighlight;
+}
+
+void MarkdownHighlighterPrivate::rehighlightVisibleBlocks()
+{
+    Q_Q(MarkdownHighlighter);
+
+    int firstVisibleBlock;
+    int lastVisibleBlock;
+
+    editor->visibleBlockRange(firstVisibleBlock, lastVisibleBlock);
+
+    QTextBlock block = q->document()->findBlockByNumber(firstVisibleBlock);
+
+    while (block.isValid() && (block.blockNumber() <= lastVisibleBlock)) {
+        if (isRehighlightPending(block.blockNumber())) {
+            updateBlock(block, sweepMode);
+
+            // Advance the sweep past the block if it was next, so that
+            // it isn't highlighted twice.
+            //
+            if (block.blockNumber() == nextBlockToRehighlight) {
+                nextBlockToRehighlight = (nextBlockToRehighlight + 1) % rehighlightBlockCount;
+                blocksLeftToRehighlight--;
+            }
+        }
+
+        block = block.next();
+    }
+}
+
+void MarkdownHighlighterPrivate::rehighlightNextSlice()
+{
+    Q_Q(MarkdownHighlighter);
+
+    QElapsedTimer sliceTimer;
+    sliceTimer.start();
+
+    QTextBlock block = q->document()->findBlockByNumber(nextBlockToRehighlight);
+
+    while ((blocksLeftToRehighlight > 0) && !sliceTimer.hasExpired(RehighlightSliceMsecs)) {
+        if (!block.isValid()) {
+            block = q->document()->firstBlock();
+        }
+
+        updateBlock(block, sweepMode);
+        block = block.next();
+        nextBlockToRehighlight = (nextBlockToRehighlight + 1) % rehighlightBlockCount;
+        blocksLeftToRehighlight--;
+    }
+
+    if (blocksLeftToRehighlight > 0) {
+        rehighlightTimer->start();
+    }
+}
+
+void MarkdownHighlighterPrivate::onBlockCountChanged(const int newBlockCount)
+{
+    if (blocksLeftToRehighlight <= 0) {
+        rehighlightBlockCount = newBlockCount;
+        return;
+    }
+
+    // Blocks edited while a rehighlight is in progress are highlighted
+    // as they change, but removing blocks ahead of the sweep shifts
+    // blocks it has yet to reach behind it.  Step the sweep back to
+    // keep from skipping them.  Added blocks extend the sweep.
+    //
+    int blockDelta = newBlockCount - rehighlightBlockCount;
+
+    if (blockDelta > 0) {
+        blocksLeftToRehighlight += blockDelta;
+    } else {
+        nextBlockToRehighlight = qMax(0, nextBlockToRehighlight + blockDelta);
+    }
+
+    rehighlightBlockCount = newBlockCount;
+    blocksLeftToRehighlight = qMin(blocksLeftToRehighlight, newBlockCount);
+    nextBlockToRehighlight = qMin(nextBlockToRehighlight, newBlockCount - 1);
 }
 
 void MarkdownHighlighterPrivate::spellCheck(const QString &text)
@@ -386,47 +788,50 @@ void MarkdownHighlighterPrivate::spellCheck(const QString &text)
         cursorPosInBlock = cursorPosition - cursorPosBlock.position();
     }
 
-    QStringRef misspelledWord = dictionary.check(text, 0);
-
-    while (!misspelledWord.isNull()) {
-        int startIndex = misspelledWord.position();
-        int length = misspelledWord.length();
+    // The block being typed in is checked ahead of the rest once the
+    // user pauses.  Until its results arrive, the words found in the
+    // block's previous text (if any) are marked.
+    //
+    QVector<MisspelledWord> words;
+    bool prioritize = typingPaused && (cursorPosInBlock >= 0);
+    bool checked = spellChecker->misspelledWords(q->currentBlock(), text, prioritize, words);
 
-        if (typingPaused || (cursorPosInBlock != (startIndex + length))) {
-            QTextCharFormat spellingErrorFormat = q->format(startIndex);
-            spellingErrorFormat.setUnderlineColor(colors.error);
-            spellingErrorFormat.setUnderlineStyle
-            (
-                (QTextCharFormat::UnderlineStyle)
-                QApplication::style()->styleHint
-                (
-                    QStyle::SH_SpellCheckUnderlineStyle
-                )
-            );
+    foreach (const MisspelledWord &word, words) {
+        int end = word.position + word.length;
 
-            q->setFormat(startIndex, length, spellingErrorFormat);
+        if (typingPaused || (cursorPosInBlock != end)) {
+            for (int i = word.position; (i < end) && (i < lineFormats.size()); i++) {
+                lineFormats[i] = withFlag(lineFormats[i], SpellingErrorFlag);
+            }
         }
 
-        startIndex += length;
-        misspelledWord = dictionary.check(text, startIndex);
+        // Have suggestions ready for the misspellings near the cursor,
+        // which are the most likely to be corrected.
+        //
+        if (checked && prioritize) {
+            spellChecker->prefetchSuggestions(text.mid(word.position, word.length));
+        }
     }
 }
 
-void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *const node)
+void MarkdownHighlighterPrivate::applyFormattingForNode
+(
+    const MarkdownNode *const node,
+    const QString &text,
+    const int line
+)
 {
     Q_Q(MarkdownHighlighter);
     
     MarkdownNode::NodeType type = node->type();
     int pos = node->position();
     int length = node->length();
-    int currentLine = q->currentBlock().blockNumber() + 1;
-    MarkdownState state = MarkdownStateParagraphBreak;
 
-    QTextCharFormat baseFormat = defaultFormat;
-    baseFormat.setForeground(colors.foreground);
+    int currentLine = line;
+    MarkdownState state = MarkdownStateParagraphBreak;
 
+    FormatKey baseFormat = ForegroundRole;
     unsigned int indent = 0;
-    QString text = q->currentBlock().text();
 
     for (int i = 0; i < text.length(); i++) {
         if (text[i].isSpace()) {
@@ -439,42 +844,33 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
     bool inBlockquote = node->isInsideBlockquote();
 
     if (inBlockquote) {
-        baseFormat.setForeground(colors.blockquoteMarkup);
-        baseFormat.setFontItalic(italicizeBlockquotes);
-
-        q->setFormat
-        (
-            0,
-            q->currentBlock().length(),
-            baseFormat
-        );
-
-        baseFormat.setForeground(colors.blockquoteText);
+        baseFormat = withFlag(withColor(baseFormat, BlockquoteMarkupRole), BlockquoteFlag);
+        setLineFormat(0, text.length(), baseFormat);
+        baseFormat = withColor(baseFormat, BlockquoteTextRole);
     } else {
-        q->setFormat
-        (
-            0,
-            q->currentBlock().length(),
-            baseFormat
-        );
+        setLineFormat(0, text.length(), baseFormat);
     }
 
-    // Do a pre-order traversal of the nodes.
-    QStack<const MarkdownNode *> nodes;
-    QStack<QTextCharFormat> nodeFormats;
-    nodes.push(node);
-    nodeFormats.push(baseFormat);
+    // Do a pre-order traversal of the nodes.  The traversal stack rarely
+    // outgrows the preallocated size, which is kept on the call stack.
+    //
+    QVarLengthArray<const MarkdownNode *, 64> nodes;
+    QVarLengthArray<FormatKey, 64> nodeFormats;
+    nodes.append(node);
+    nodeFormats.append(baseFormat);
 
     while (!nodes.isEmpty()) {
-        const MarkdownNode *current = nodes.pop();
-        QTextCharFormat contextFormat = nodeFormats.pop();
+        const MarkdownNode *current = nodes.last();
+        FormatKey contextFormat = nodeFormats.last();
+        nodes.removeLast();
+        nodeFormats.removeLast();
         MarkdownNode::NodeType parentType = MarkdownNode::Invalid;
 
         if (nullptr != current->parent()) {
             parentType = current->parent()->type();
         }
 
-        pos = columnInLine(current, q->currentBlock().text());
+        pos = columnInLine(current, text);
         length = current->length();
         type = current->type();
 
@@ -488,26 +884,23 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                 type = parentType;
             }
 
-            QTextCharFormat format = contextFormat;
+            FormatKey format = contextFormat;
 
             switch (type) {
             case MarkdownNode::Heading:
                 length = q->currentBlock().length();
-                format.setFontWeight(QFont::Bold);
-                contextFormat.setFontWeight(QFont::Bold);
+                format = withFlag(format, BoldFlag);
+                contextFormat = withFlag(contextFormat, BoldFlag);
 
-                if (useLargeHeadings) {
-                    format.setFontPointSize(format.fontPointSize()
-                                            + (qreal)(7 - current->headingLevel()));
-                    contextFormat.setFontPointSize(format.fontPointSize());
-                }
+                format = withHeadingLevel(format, current->headingLevel());
+                contextFormat = withHeadingLevel(contextFormat, current->headingLevel());
 
                 if (inBlockquote) {
-                    format.setForeground(colors.blockquoteMarkup);
-                    contextFormat.setForeground(colors.blockquoteText);
+                    format = withColor(format, BlockquoteMarkupRole);
+                    contextFormat = withColor(contextFormat, BlockquoteTextRole);
                 } else {
-                    format.setForeground(colors.headingMarkup);
-                    contextFormat.setForeground(colors.headingText);
+                    format = withColor(format, HeadingMarkupRole);
+                    contextFormat = withColor(contextFormat, HeadingTextRole);
                 }
 
                 if (current->isSetextHeading()) {
@@ -521,15 +914,6 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                     default:
                         state = MarkdownStateUnknown;
                     }
-
-                    // Rehighlight all blocks contained within this heading node.
-                    if (currentLine != current->startLine()) {
-                        QTextBlock block = q->document()->findBlockByNumber(current->startLine() - 1);
-
-                        if (block.isValid()) {
-                            emit q->highlightBlockAtPosition(block.position());
-                        }
-                    }
                 } else {
                     switch (current->headingLevel()) {
                     case 1:
@@ -565,10 +949,8 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
 
                 break;
             case MarkdownNode::BlockQuote:
-                format.setForeground(colors.blockquoteMarkup);
-                format.setFontItalic(italicizeBlockquotes);
-                contextFormat.setForeground(colors.blockquoteText);
-                contextFormat.setFontItalic(italicizeBlockquotes);
+                format = withFlag(withColor(format, BlockquoteMarkupRole), BlockquoteFlag);
+                contextFormat = withFlag(withColor(contextFormat, BlockquoteTextRole), BlockquoteFlag);
                 inBlockquote = true;
                 break;
             case MarkdownNode::CodeBlock:
@@ -577,28 +959,27 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                     current->isFencedCodeBlock()
                     &&
                     (
-                        ((q->currentBlock().blockNumber() + 1) == current->startLine())
-                        || ((q->currentBlock().blockNumber() + 1) == current->endLine())
+                        (currentLine == current->startLine())
+                        || (currentLine == current->endLine())
                     )
                 ) {
-                    format.setForeground(colors.codeMarkup);
+                    format = withColor(format, CodeMarkupRole);
                     state = MarkdownStateCodeBlock;
                 } else if
                 (
-                    ((q->currentBlock().blockNumber() + 1) == current->endLine())
+                    (currentLine == current->endLine())
                     && (current->length() <= 0)
                 ) {
                     state = MarkdownStateParagraphBreak;
                 } else {
-                    format.setForeground(colors.codeText);
+                    format = withColor(format, CodeTextRole);
                     length = q->currentBlock().length() - pos + 1;
                     state = MarkdownStateCodeBlock;
                 }
 
                 break;
             case MarkdownNode::ListItem:
-                format.setForeground(colors.listMarkup);
-                format.setFontWeight(QFont::Bold);
+                format = withFlag(withColor(format, ListMarkupRole), BoldFlag);
 
                 if (current->isNumberedListItem()) {
                     state = MarkdownStateNumberedList;
@@ -609,26 +990,15 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                 break;
             case MarkdownNode::TaskListItem:
                 state = MarkdownStateTaskList;
-                format.setForeground(colors.listMarkup);
-                format.setFontWeight(QFont::Bold);
+                format = withFlag(withColor(format, ListMarkupRole), BoldFlag);
                 break;
             case MarkdownNode::Emph:
-                format.setForeground(colors.emphasisMarkup);
-
-                if (useUndlerlineForEmphasis) {
-                    contextFormat.setFontUnderline(true);
-                } else {
-                    contextFormat.setFontItalic(true);
-                    format.setFontItalic(true);
-                }
-
-                contextFormat.setForeground(colors.emphasisText);
+                format = withFlag(withColor(format, EmphasisMarkupRole), EmphasisMarkupFlag);
+                contextFormat = withFlag(withColor(contextFormat, EmphasisTextRole), EmphasisTextFlag);
                 break;
             case MarkdownNode::Strong:
-                contextFormat.setForeground(colors.emphasisText);
-                contextFormat.setFontWeight(QFont::Bold);
-                format.setForeground(colors.emphasisMarkup);
-                format.setFontWeight(QFont::Bold);
+                contextFormat = withFlag(withColor(contextFormat, EmphasisTextRole), BoldFlag);
+                format = withFlag(withColor(format, EmphasisMarkupRole), BoldFlag);
                 break;
             case MarkdownNode::Code: {
                 int backticks = 0;
@@ -641,50 +1011,49 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                     }
                 }
 
-                format.setForeground(colors.codeMarkup);
-                q->setFormat
+                setLineFormat
                 (
                     pos - backticks,
                     length + (2 * backticks),
-                    format
+                    withColor(format, CodeMarkupRole)
                 );
-                format.setForeground(colors.codeText);
+                format = withColor(format, CodeTextRole);
                 break;
             }
             case MarkdownNode::HtmlInline:
-                format.setForeground(colors.inlineHtml);
-                contextFormat.setForeground(colors.inlineHtml);
+                format = withColor(format, InlineHtmlRole);
+                contextFormat = withColor(contextFormat, InlineHtmlRole);
                 break;
             case MarkdownNode::Link:
-                format.setForeground(colors.link);
-                contextFormat.setForeground(colors.link);
+                format = withColor(format, LinkRole);
+                contextFormat = withColor(contextFormat, LinkRole);
                 break;
             case MarkdownNode::Image:
-                format.setForeground(colors.image);
-                contextFormat.setForeground(colors.image);
+                format = withColor(format, ImageRole);
+                contextFormat = withColor(contextFormat, ImageRole);
                 break;
             case MarkdownNode::ThematicBreak:
-                format.setForeground(colors.divider);
+                format = withColor(format, DividerRole);
                 state = MarkdownStateHorizontalRule;
                 break;
             case MarkdownNode::FootnoteReference:
-                format.setForeground(colors.link);
-                contextFormat.setForeground(colors.link);
+                format = withColor(format, LinkRole);
+                contextFormat = withColor(contextFormat, LinkRole);
                 break;
             case MarkdownNode::FootnoteDefinition:
-                format.setForeground(colors.link);
-                contextFormat.setForeground(colors.link);
+                format = withColor(format, LinkRole);
+                contextFormat = withColor(contextFormat, LinkRole);
                 state = MarkdownStateParagraph;
                 break;
             case MarkdownNode::TableHeading:
-                format.setForeground(colors.emphasisMarkup);
+                format = withColor(format, EmphasisMarkupRole);
                 pos = 0;
                 length = q->currentBlock().length();
-                contextFormat.setFontWeight(QFont::Bold);
+                contextFormat = withFlag(contextFormat, BoldFlag);
                 state = MarkdownStatePipeTableHeader;
                 break;
             case MarkdownNode::TableRow:
-                format.setForeground(colors.emphasisMarkup);
+                format = withColor(format, EmphasisMarkupRole);
                 pos = 0;
                 length = q->currentBlock().length();
                 state = MarkdownStatePipeTableRow;
@@ -697,26 +1066,26 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                     (nullptr != current->parent())
                     && (MarkdownNode::TableHeading == current->parent()->type())
                 ) {
-                    format.setFontWeight(QFont::Bold);
+                    format = withFlag(format, BoldFlag);
                 }
                 break;
             case MarkdownNode::Table:
-                format.setForeground(colors.emphasisMarkup);
+                format = withColor(format, EmphasisMarkupRole);
                 pos = 0;
                 length = q->currentBlock().length();
                 state = MarkdownStatePipeTableDivider;
                 break;
             case MarkdownNode::Strikethrough:
-                format.setForeground(colors.emphasisMarkup);
-                contextFormat.setFontStrikeOut(true);
+                format = withColor(format, EmphasisMarkupRole);
+                contextFormat = withFlag(contextFormat, StrikeOutFlag);
                 break;
             default:
-                if (referenceDefinitionRegex.match(q->currentBlock().text()).hasMatch()) {
+                if (referenceDefinitionRegex.match(text).hasMatch()) {
                     pos = 0;
-                    length = q->currentBlock().text().indexOf(':') + 1;
-                    format.setForeground(colors.link);
+                    length = text.indexOf(':') + 1;
+                    format = withColor(format, LinkRole);
                 } else if (inBlockquote) {
-                    format.setForeground(colors.blockquoteMarkup);
+                    format = withColor(format, BlockquoteMarkupRole);
                 }
 
                 break;
@@ -726,7 +1095,7 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
                 length = q->currentBlock().length();
             }
 
-            q->setFormat
+            setLineFormat
             (
                 pos,
                 length,
@@ -734,19 +1103,16 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
             );
 
             if (MarkdownNode::Text == type) {
-                highlightRefLinks(pos, length);
+                highlightRefLinks(text, pos, length);
             } else if (MarkdownNode::TaskListItem == type) {
-                format = contextFormat;
-                format.setForeground(colors.link);
-
                 int checkboxStart = text.indexOf('[');
                 int checkboxEnd = text.indexOf(']');
 
-                q->setFormat
+                setLineFormat
                 (
                     checkboxStart,
                     checkboxEnd - checkboxStart + 1,
-                    format
+                    withColor(contextFormat, LinkRole)
                 );
             }
         }
@@ -754,8 +1120,8 @@ void MarkdownHighlighterPrivate::applyFormattingForNode(const MarkdownNode *cons
         MarkdownNode *child = current->lastChild();
 
         while ((nullptr != child) && (!child->isInvalid())) {
-            nodes.push(child);
-            nodeFormats.push(contextFormat);
+            nodes.append(child);
+            nodeFormats.append(contextFormat);
             child = child->previous();
         }
     }
@@ -790,11 +1156,11 @@ int MarkdownHighlighterPrivate::columnInLine(const MarkdownNode *const node, con
 
         switch (node->type()) {
         case MarkdownNode::Text:
-            pos = text.indexOf(node->text()[0]);
+            pos = text.indexOf(ast->text(node).at(0));
 
-            if (node->text().startsWith('`')) {
+            if (ast->text(node).startsWith('`')) {
                 int retValue = pos;
-                pos += node->text().length() - node->length();
+                pos += ast->text(node).length() - node->length();
                 offset = node->position() - pos;
                 return retValue;
             }
@@ -813,7 +1179,15 @@ int MarkdownHighlighterPrivate::columnInLine(const MarkdownNode *const node, con
             break;
         case MarkdownNode::Emph:
         case MarkdownNode::Strong:
-            pos = text.indexOf(QRegularExpression("[*_]"));
+            pos = -1;
+
+            for (int i = 0; i < text.length(); i++) {
+                if (('*' == text[i]) || ('_' == text[i])) {
+                    pos = i;
+                    break;
+                }
+            }
+
             break;
         case MarkdownNode::Link:
             pos = text.indexOf('[');
@@ -828,52 +1202,46 @@ int MarkdownHighlighterPrivate::columnInLine(const MarkdownNode *const node, con
             pos = text.indexOf('~');
             break;
         default:
-            pos = text.indexOf(node->text()[0]);
+            pos = text.indexOf(ast->text(node).at(0));
             break;
         }
 
         offset = node->position() - pos;
-
-        // When characters larger than one byte are intermixed with single-byte
-        // Latin-1 characters, the column number gets shifted by one.
-        // Subtrace one from the offset to account for this.
-        //
-        if (text.toUtf8().length() != text.toLatin1().length())
-        {
-            offset -= 1;
-        }
     }
 
     return node->position() - offset;
 }
 
-void MarkdownHighlighterPrivate::highlightRefLinks(const int pos, const int length)
+void MarkdownHighlighterPrivate::highlightRefLinks
+(
+    const QString &text,
+    const int pos,
+    const int length
+)
 {
-    Q_Q(MarkdownHighlighter);
-
-    QStack<int> bracketPos;
+    QVarLengthArray<int, 16> bracketPos;
     bool skipNext = false;
-    QTextCharFormat format = q->format(pos);
-    format.setForeground(colors.link);
+    FormatKey format = withColor(lineFormats.value(pos), LinkRole);
 
-    for (int i = pos; i < (pos + length) && (i < q->currentBlock().text()); i++) {
+    for (int i = pos; i < (pos + length) && (i < text.length()); i++) {
         if (skipNext) {
             skipNext = false;
             continue;
         }
 
-        switch (q->currentBlock().text()[i].toLatin1()) {
+        switch (text[i].toLatin1()) {
         case '\\':
             skipNext = true;
             break;
         case '[':
-            bracketPos.push(i);
+            bracketPos.append(i);
             break;
         case ']':
             if (!bracketPos.isEmpty()) {
-                int start = bracketPos.pop();
+                int start = bracketPos.last();
 
-                q->setFormat(start, (i - start + 1), format);
+                bracketPos.removeLast();
+                setLineFormat(start, (i - start + 1), format);
             }
 
             break;
@@ -883,6 +1251,39 @@ void MarkdownHighlighterPrivate::highlightRefLinks(const int pos, const int leng
     }
 }
 
+MarkdownNode *MarkdownHighlighterPrivate::blockAtLine
+(
+    const QSharedPointer<MarkdownAST> &ast,
+    const int line
+)
+{
+    int offset = line - blockCacheFirstLine;
+
+    if ((ast == this->ast) && (offset >= 0) && (offset < blockCache.size())) {
+        return blockCache[offset];
+    }
+
+    // Bulk rehighlighting proceeds line by line, so grow the batch of
+    // lines looked up ahead while the lines keep following on from the
+    // previous batch, and start over with a single line otherwise.
+    //
+    if ((ast == this->ast) && (offset == blockCache.size())) {
+        blockCacheBatchSize = qMin(2 * blockCacheBatchSize, MaxBlockCacheBatchSize);
+    } else {
+        blockCacheBatchSize = 1;
+    }
+
+    this->ast = ast;
+    blockCacheFirstLine = line;
+    blockCache = ast->findBlocksInLineRange(line, line + blockCacheBatchSize - 1);
+
+    if (blockCache.isEmpty()) {
+        return nullptr;
+    }
+
+    return blockCache[0];
+}
+
 bool MarkdownHighlighterPrivate::lineMatchesNode(const int line, const MarkdownNode *const node) const
 {
     return
@@ -909,14 +1310,196 @@ bool MarkdownHighlighterPrivate::lineMatchesNode(const int line, const MarkdownN
         );
 }
 
-bool MarkdownHighlighterPrivate::isSetextHeadingState(const int state)
+MarkdownHighlighterPrivate::FormatKey MarkdownHighlighterPrivate::withColor
+(
+    const FormatKey key,
+    const ColorRole role
+)
 {
-    switch (state & MarkdownStateMask) {
-    case MarkdownStateSetextHeading1:
-    case MarkdownStateSetextHeading2:
-        return true;
+    return (key & ~((FormatKey) ColorRoleMask)) | role;
+}
+
+MarkdownHighlighterPrivate::FormatKey MarkdownHighlighterPrivate::withFlag
+(
+    const FormatKey key,
+    const FormatFlag flag,
+    const bool enabled
+)
+{
+    if (enabled) {
+        return key | flag;
+    }
+
+    return key & ~((FormatKey) flag);
+}
+
+MarkdownHighlighterPrivate::FormatKey MarkdownHighlighterPrivate::withHeadingLevel
+(
+    const FormatKey key,
+    const int level
+)
+{
+    return (key & ~HeadingLevelMask)
+        | ((((FormatKey) level) << HeadingLevelShift) & HeadingLevelMask);
+}
+
+QColor MarkdownHighlighterPrivate::color(const ColorRole role) const
+{
+    switch (role) {
+    case BlockquoteMarkupRole:
+        return colors.blockquoteMarkup;
+    case BlockquoteTextRole:
+        return colors.blockquoteText;
+    case HeadingMarkupRole:
+        return colors.headingMarkup;
+    case HeadingTextRole:
+        return colors.headingText;
+    case CodeMarkupRole:
+        return colors.codeMarkup;
+    case CodeTextRole:
+        return colors.codeText;
+    case ListMarkupRole:
+        return colors.listMarkup;
+    case EmphasisMarkupRole:
+        return colors.emphasisMarkup;
+    case EmphasisTextRole:
+        return colors.emphasisText;
+    case InlineHtmlRole:
+        return colors.inlineHtml;
+    case LinkRole:
+        return colors.link;
+    case ImageRole:
+        return colors.image;
+    case DividerRole:
+        return colors.divider;
+    case TransparentRole:
+        return QColor(Qt::transparent);
     default:
-        return false;
+        return colors.foreground;
+    }
+}
+
+const QTextCharFormat &MarkdownHighlighterPrivate::internedFormat(const FormatKey key)
+{
+    QHash<FormatKey, QTextCharFormat>::const_iterator cached = formatCache.constFind(key);
+
+    if (formatCache.constEnd() != cached) {
+        return cached.value();
+    }
+
+    QTextCharFormat format;
+    int headingLevel = (key & HeadingLevelMask) >> HeadingLevelShift;
+
+    format.setProperty(FormatKeyProperty, key);
+    format.setFontStyleStrategy(QFont::PreferAntialias);
+    format.setForeground(color((ColorRole) (key & ColorRoleMask)));
+
+    if (key & BoldFlag) {
+        format.setFontWeight(QFont::Bold);
+    }
+
+    if
+    (
+        ((key & (EmphasisTextFlag | EmphasisMarkupFlag)) && !useUndlerlineForEmphasis)
+        || ((key & BlockquoteFlag) && italicizeBlockquotes)
+    ) {
+        format.setFontItalic(true);
+    }
+
+    if ((key & EmphasisTextFlag) && useUndlerlineForEmphasis) {
+        format.setFontUnderline(true);
+    }
+
+    if (key & StrikeOutFlag) {
+        format.setFontStrikeOut(true);
+    }
+
+    if (useLargeHeadings && (headingLevel > 0)) {
+        format.setFontPointSize(fontPointSize + (qreal) (7 - headingLevel));
+    }
+
+    if (key & SpellingErrorFlag) {
+        format.setUnderlineColor(colors.error);
+        format.setUnderlineStyle
+        (
+            (QTextCharFormat::UnderlineStyle)
+            QApplication::style()->styleHint
+            (
+                QStyle::SH_SpellCheckUnderlineStyle
+            )
+        );
+    }
+
+    return formatCache.insert(key, format).value();
+}
+
+void MarkdownHighlighterPrivate::setLineFormat(int start, int length, const FormatKey key)
+{
+    int end = qMin(start + length, lineFormats.size());
+
+    for (int i = qMax(start, 0); i < end; i++) {
+        lineFormats[i] = key;
+    }
+}
+
+void MarkdownHighlighterPrivate::restyleCurrentBlock()
+{
+    Q_Q(MarkdownHighlighter);
+
+    const QVector<QTextLayout::FormatRange> formats =
+        q->currentBlock().layout()->formats();
+
+    for (int i = 0; i < formats.size(); i++) {
+        QVariant key = formats[i].format.property(FormatKeyProperty);
+
+        if (key.isValid()) {
+            q->setFormat(formats[i].start, formats[i].length, internedFormat(key.toUInt()));
+        } else {
+            q->setFormat(formats[i].start, formats[i].length, formats[i].format);
+        }
+    }
+}
+
+void MarkdownHighlighterPrivate::respellCurrentBlock(const QString &text)
+{
+    Q_Q(MarkdownHighlighter);
+
+    const QVector<QTextLayout::FormatRange> formats =
+        q->currentBlock().layout()->formats();
+
+    lineFormats.fill(ForegroundRole, text.length());
+
+    for (int i = 0; i < formats.size(); i++) {
+        QVariant key = formats[i].format.property(FormatKeyProperty);
+
+        if (key.isValid()) {
+            setLineFormat
+            (
+                formats[i].start,
+                formats[i].length,
+                withFlag(key.toUInt(), SpellingErrorFlag, false)
+            );
+        }
+    }
+
+    if (spellCheckEnabled) {
+        spellCheck(text);
+    }
+
+    applyLineFormats();
+}
+
+void MarkdownHighlighterPrivate::applyLineFormats()
+{
+    Q_Q(MarkdownHighlighter);
+
+    int runStart = 0;
+
+    for (int i = 1; i <= lineFormats.size(); i++) {
+        if ((lineFormats.size() == i) || (lineFormats[i] != lineFormats[runStart])) {
+            q->setFormat(runStart, i - runStart, internedFormat(lineFormats[runStart]));
+            runStart = i;
+        }
     }
 }
 } // namespace ghostwriter
@@ -31,6 +31,7 @@ namespace ghostwriter
 /**
  * Highlighter for the Markdown text format.
  */
+class BackgroundSpellChecker;
 class MarkdownHighlighterPrivate;
 class MarkdownHighlighter : public QSyntaxHighlighter
 {
@@ -61,6 +62,12 @@ public:
      */
     void highlightBlock(const QString &text);
 
+    /**
+     * Gets the spell checker used for live spell checking, from which
+     * spelling suggestions can also be looked up.
+     */
+    BackgroundSpellChecker *spellChecker() const;
+
     /**
      * Sets the dictionary to use for live spell checking.
      */
@@ -77,7 +84,8 @@ public:
     void decreaseFontSize();
 
     /**
-     * Sets the color scheme.
+     * Sets the color scheme.  The blocks keep their highlighting and
+     * are only restyled with the new colors.
      */
     void setColorScheme(const ColorScheme &colors);
 
@@ -97,7 +105,9 @@ public:
     void setItalicizeBlockquotes(const bool enable);
 
     /**
-     * Sets the font family and point size.
+     * Sets the font family and point size.  The highlighting leaves the
+     * font family and size to the document's font, so only large
+     * headings are restyled when the size changes.
      */
     void setFont(const QString &fontFamily, const double fontSize);
 
@@ -106,22 +116,16 @@ public:
      */
     void setSpellCheckEnabled(const bool enabled);
 
-signals:
+public slots:
     /**
-     * FOR INTERNAL USE ONLY
-     *
-     * This signal is used internally to restart highlighting on the
-     * previous line, which is needed for setext headings.  Unfortunately,
-     * QSyntaxHighlighter only goes forward in its highlighting, not
-     * backwards.  Neither can rehighlightBlock() be called internally,
-     * since recursive calls to the class will wipe its state data and will
-     * cause the application to crash. This is a workaround to queue a
-     * highlighting action for the prior text block in the event system,
-     * so that recursion isn't used.
+     * Rehighlights the whole document without blocking the user
+     * interface.  The blocks visible in the editor are highlighted at
+     * once, and the rest in time slices from the event loop, with blocks
+     * scrolled into view highlighted ahead of the others.  Scheduling
+     * a rehighlight restarts any rehighlight still in progress.
      */
-    void highlightBlockAtPosition(int position);
+    void scheduleRehighlight();
 
-public slots:
     /**
      * Signalled by a text editor when the user has resumed typing.
      * This signal is used to ensure spell checking is not performed
@@ -150,10 +154,12 @@ public slots:
 
 private slots:
     /*
-    * Highlights the text block at the given cursor position of the
-    * document.  See explanation for highlightBlockAtPosition().
+    * Rehighlights the given lines of the document in one pass after a
+    * new AST snapshot has been parsed.  These include the lines above
+    * an edit whose context changed, such as for setext headings and
+    * pipe tables, since QSyntaxHighlighter only highlights forward.
     */
-    void onHighlightBlockAtPosition(int position);
+    void onMarkdownASTChanged(const LineRangeSet &changedLines);
 
 private:
     QScopedPointer<MarkdownHighlighterPrivate> d_ptr;
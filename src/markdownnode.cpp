@@ -30,54 +30,45 @@
 namespace ghostwriter
 {
 MarkdownNode::MarkdownNode() :
-    m_type(Invalid),
-    m_parent(NULL),
-    m_prev(NULL),
-    m_next(NULL),
-    m_firstChild(NULL),
-    m_lastChild(NULL),
+    m_index(NoNode),
+    m_parent(NoNode),
+    m_prev(NoNode),
+    m_next(NoNode),
+    m_firstChild(NoNode),
+    m_lastChild(NoNode),
     m_startLine(0),
     m_endLine(0),
     m_position(0),
     m_length(0),
+    m_textOffset(0),
+    m_textLength(0),
+    m_listStartNum(0),
+    m_type(Invalid),
+    m_textStorage(NoText),
     m_fenceChar('\0'),
-    m_headingLevel(0),
-    m_listStartNum(0)
+    m_headingLevel(0)
 {
     ;
 }
 
-MarkdownNode::MarkdownNode
-(
-    cmark_node *node
-)
-{
-    MarkdownNode();
-
-    if (NULL == node) {
-        return;
-    }
-
-    setDataFrom(node);
-}
-
 MarkdownNode::~MarkdownNode()
 {
     ;
 }
 
-void MarkdownNode::setDataFrom(cmark_node *node)
+void MarkdownNode::setDataFrom(cmark_node *node, const Utf8ColumnMap &columnMap)
 {
     // Copy data.
     m_type = nodeType(node);
-    m_position = cmark_node_get_start_column(node) - 1;
-    m_length = cmark_node_get_end_column(node) - cmark_node_get_start_column(node) + 1;
     m_startLine = cmark_node_get_start_line(node);
     m_endLine = cmark_node_get_end_line(node);
 
-    if (!isBlockType()) {
-        m_text = QString::fromUtf8(cmark_node_get_literal(node));
-    }
+    // cmark-gfm's columns count bytes starting at 1, and the end column
+    // is that of the node's last byte.  The end column is therefore also
+    // the byte offset just past the end of the node.
+    //
+    m_position = columnMap.utf16Offset(m_startLine, cmark_node_get_start_column(node) - 1);
+    m_length = columnMap.utf16Offset(m_endLine, cmark_node_get_end_column(node), true) - m_position;
 
     if (CodeBlock == m_type) {
         int len;
@@ -91,82 +82,61 @@ void MarkdownNode::setDataFrom(cmark_node *node)
         }
     } else if (Heading == m_type) {
         m_headingLevel = cmark_node_get_heading_level(node);
-        m_text = QString::fromUtf8(cmark_node_get_string_content(node));
-        m_text = this->m_text.simplified();
     }
 }
 
 MarkdownNode *MarkdownNode::parent() const
 {
-    return m_parent;
+    return nodeAt(m_parent);
 }
 
 void MarkdownNode::appendChild(MarkdownNode *node)
 {
     if (NULL != node) {
-        node->m_parent = this;
+        node->m_parent = m_index;
 
-        if (NULL == m_firstChild) {
-            m_firstChild = node;
-            m_lastChild = node;
-            node->m_prev = NULL;
-            node->m_next = NULL;
+        if (NoNode == m_firstChild) {
+            m_firstChild = node->m_index;
+            m_lastChild = node->m_index;
+            node->m_prev = NoNode;
+            node->m_next = NoNode;
         } else {
-            m_lastChild->m_next = node;
+            nodeAt(m_lastChild)->m_next = node->m_index;
             node->m_prev = m_lastChild;
-            node->m_next = NULL;
-            m_lastChild = node;
+            node->m_next = NoNode;
+            m_lastChild = node->m_index;
         }
     }
 }
 
 MarkdownNode *MarkdownNode::firstChild() const
 {
-    return m_firstChild;
+    return nodeAt(m_firstChild);
 }
 
 MarkdownNode *MarkdownNode::lastChild() const
 {
-    return m_lastChild;
+    return nodeAt(m_lastChild);
 }
 
 MarkdownNode *MarkdownNode::previous() const
 {
-    return m_prev;
+    return nodeAt(m_prev);
 }
 
 MarkdownNode *MarkdownNode::next() const
 {
-    return m_next;
+    return nodeAt(m_next);
 }
 
 QString MarkdownNode::toString() const
 {
-    int left = 20;
-    int right = 20;
-    QString text = this->text();
-
-    if (text.isNull()) {
-        text = "<<Empty Node>>";
-    }
-
-    if (left > text.length()) {
-        left = text.length();
-    }
-
-    right = text.length() - left;
-
-    if (right < 0) {
-        right = 0;
-    }
-
-    return QString("> [lines %1 - %2][col %3, len %5] %6 -> %7")
+    return QString("> [lines %1 - %2][col %3, len %5] %6")
            .arg(startLine())
            .arg(endLine())
            .arg(position())
            .arg(length())
-           .arg(toString(m_type))
-           .arg(this->text().left(left) + "..." + this->text().right(right));
+           .arg(toString(type()));
 }
 
 bool MarkdownNode::isInvalid() const
@@ -176,7 +146,7 @@ bool MarkdownNode::isInvalid() const
 
 MarkdownNode::NodeType MarkdownNode::type() const
 {
-    return m_type;
+    return (NodeType) m_type;
 }
 
 int MarkdownNode::position() const
@@ -199,9 +169,14 @@ int MarkdownNode::endLine() const
     return m_endLine;
 }
 
-QString MarkdownNode::text() const
+void MarkdownNode::shiftLines(int offset)
 {
-    return m_text;
+    m_startLine += offset;
+
+    // An end line of zero means the node has no known end.
+    if (m_endLine > 0) {
+        m_endLine += offset;
+    }
 }
 
 bool MarkdownNode::isBlockType() const
@@ -284,9 +259,9 @@ int MarkdownNode::listItemNumber() const
     int startNum = m_listStartNum;
     int count = 1;
 
-    MarkdownNode *p = m_prev;
+    MarkdownNode *p = previous();
 
-    while ((p != NULL) && (p != m_parent)) {
+    while ((p != NULL) && (p != parent())) {
         count++;
         p = p->previous();
     }
@@ -378,6 +353,18 @@ MarkdownNode::NodeType MarkdownNode::nodeType(cmark_node *node)
     return Invalid;
 }
 
+MarkdownNode *MarkdownNode::nodeAt(qint32 index) const
+{
+    if (NoNode == index) {
+        return nullptr;
+    }
+
+    // All nodes of an AST are stored contiguously, so a relative's
+    // address is at its offset in the storage from this node.
+    //
+    return const_cast<MarkdownNode *>(this) + (index - m_index);
+}
+
 QString MarkdownNode::toString(NodeType nodeType) const
 {
     switch (nodeType) {
@@ -22,6 +22,9 @@
 
 #include <QChar>
 #include <QString>
+#include <QtGlobal>
+
+#include "utf8columnmap.h"
 
 class cmark_node;
 
@@ -29,9 +32,18 @@ namespace ghostwriter
 {
 /**
  * Markdown node wrapper for cmark-gfm node.
+ *
+ * Nodes are stored contiguously by the MarkdownAST that owns them, and
+ * link to their relatives by index into that storage rather than by
+ * pointer.  A node's text is likewise held by its MarkdownAST.  Use
+ * MarkdownAST::text() to retrieve it.
  */
+class MarkdownASTPrivate;
 class MarkdownNode
 {
+    friend class MarkdownAST;
+    friend class MarkdownASTPrivate;
+
 public:
 
     typedef enum {
@@ -80,23 +92,18 @@ public:
      */
     MarkdownNode();
 
-    /**
-     * Constructor.  Copies data from provided cmark_node.
-     */
-    MarkdownNode
-    (
-        cmark_node *node
-    );
-
     /**
      * Destructor.
      */
     ~MarkdownNode();
 
     /**
-     * Copies data from the provided cmark_node.
+     * Copies data from the provided cmark_node.  The column map of the
+     * parsed text converts cmark-gfm's byte columns into positions
+     * within the lines of the original QString.  The node's text is
+     * not copied.
      */
-    void setDataFrom(cmark_node *node);
+    void setDataFrom(cmark_node *node, const Utf8ColumnMap &columnMap);
 
     /**
      * Returns a string representation of this node.
@@ -114,7 +121,8 @@ public:
     MarkdownNode *parent() const;
 
     /**
-     * Appends the given node as a child to this node.
+     * Appends the given node as a child to this node.  Both nodes must
+     * be stored by the same MarkdownAST.
      */
     void appendChild(MarkdownNode *node);
 
@@ -169,9 +177,11 @@ public:
     int endLine() const;
 
     /**
-     * Returns the text contained in this node.
+     * Adds the given offset to the start and end lines of this node.
+     * Use this method to relocate a node when lines are inserted or
+     * removed before it in the original Markdown text.
      */
-    QString text() const;
+    void shiftLines(int offset);
 
     /**
      * Returns true of this node has a block type.
@@ -226,21 +236,43 @@ public:
     bool isBulletListItem() const;
 
 private:
-    NodeType m_type;
-    MarkdownNode *m_parent;
-    MarkdownNode *m_prev;
-    MarkdownNode *m_next;
-    MarkdownNode *m_firstChild;
-    MarkdownNode *m_lastChild;
-    QString m_text;
-    int m_startLine;
-    int m_endLine;
-    int m_position;
-    int m_length;
-
-    // NOTE: Don't encapsulate any of the following fields
-    //       in a union construct, as alignment padding will
-    //       negate the space-saving benefit.
+    // Index used for missing links.
+    static const qint32 NoNode = -1;
+
+    typedef enum {
+        NoText,
+        SourceText,
+        PooledText
+    } TextStorage;
+
+    // Indices of this node and its relatives in the node storage
+    // of the MarkdownAST.
+    //
+    qint32 m_index;
+    qint32 m_parent;
+    qint32 m_prev;
+    qint32 m_next;
+    qint32 m_firstChild;
+    qint32 m_lastChild;
+
+    qint32 m_startLine;
+    qint32 m_endLine;
+    qint32 m_position;
+    qint32 m_length;
+
+    // Span of the node's text.  For source text, the offset is the
+    // column within the start line of the original Markdown text.  For
+    // pooled text (which differs from the source, such as when escapes
+    // are present), the offset is into the text pool of the MarkdownAST.
+    //
+    qint32 m_textOffset;
+    qint32 m_textLength;
+
+    // Numbered list starting number if node is a numbered list item.
+    qint32 m_listStartNum;
+
+    quint8 m_type;
+    quint8 m_textStorage;
 
     // Fence character used for fenced code blocks, or else null character.
     unsigned char m_fenceChar;
@@ -248,8 +280,7 @@ private:
     // Heading level if node is a heading.
     unsigned char m_headingLevel;
 
-    // Numbered list starting number if node is a numbered list item.
-    int m_listStartNum;
+    MarkdownNode *nodeAt(qint32 index) const;
 
     NodeType nodeType(cmark_node *node);
 
@@ -257,4 +288,6 @@ private:
 };
 } // namespace ghostwriter
 
+Q_DECLARE_TYPEINFO(ghostwriter::MarkdownNode, Q_MOVABLE_TYPE);
+
 #endif
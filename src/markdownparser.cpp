@@ -0,0 +1,956 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <limits>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QStringRef>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "cmarkgfmapi.h"
+#include "markdownparser.h"
+
+namespace ghostwriter
+{
+/**
+ * A request to parse a revision of the text.  Rather than storing
+ * line numbers, the range of changed lines is stored as the number of
+ * unchanged lines at the start and end of the text, so that consecutive
+ * requests can be coalesced simply by taking the minimum of each.
+ */
+typedef struct ParseRequest
+{
+    int revision;
+    QString text;
+    int unchangedHeadLines;
+    int unchangedTailLines;
+    bool renderHtml;
+} ParseRequest;
+
+class MarkdownParserThread;
+
+class MarkdownParserPrivate
+{
+    Q_DECLARE_PUBLIC(MarkdownParser)
+
+public:
+    MarkdownParserPrivate(MarkdownParser *q_ptr)
+        : q_ptr(q_ptr)
+    {
+        ;
+    }
+
+    ~MarkdownParserPrivate()
+    {
+        ;
+    }
+
+    MarkdownParser *q_ptr;
+    MarkdownParserThread *thread;
+
+    // Shared between the GUI and parser threads.  Guarded by mutex.
+    // A pending request is only parsed once its text has been supplied,
+    // and the text is only requested while no parse is in progress.
+    //
+    QMutex mutex;
+    QWaitCondition requestQueued;
+    ParseRequest request;
+    bool requestPending;
+    bool textSupplied;
+    bool textRequested;
+    bool parsing;
+    bool reparseRequested;
+    bool stopRequested;
+    bool htmlRenderingEnabled;
+
+    // Accessed only by the parser thread.  These hold the most recently
+    // parsed AST along with the text and revision from which it was
+    // parsed.
+    QSharedPointer<MarkdownAST> ast;
+    int revision;
+    QString text;
+    QVector<int> lineStarts;
+    bool referenceDefinitionsFound;
+
+    // Lines changed by any ASTs that were superseded before they could
+    // be emitted, numbered as in the most recently parsed text.
+    bool changesUnpublished;
+    LineRangeSet unpublishedLines;
+
+    QRegularExpression referenceDefinitionRegex;
+    QRegularExpression setextUnderlineRegex;
+    QRegularExpression fenceRegex;
+    QRegularExpression htmlBlockStartRegex;
+    QRegularExpression listItemStartRegex;
+
+    void run();
+    void processRequest(const ParseRequest &parseRequest);
+    void reparse(bool renderHtml);
+    void publish
+    (
+        int astRevision,
+        const QSharedPointer<MarkdownAST> &newAst,
+        const LineRangeSet &changedLines
+    );
+
+    bool findBlocksToReparse
+    (
+        const QString &newText,
+        const QVector<int> &newLineStarts,
+        int lineDelta,
+        int &firstLine,
+        int &lastLine
+    ) const;
+
+    void findChangedBlocks
+    (
+        const MarkdownAST *newAst,
+        int lineCount,
+        int lineDelta,
+        int &firstLine,
+        int &lastLine
+    ) const;
+
+    LineRangeSet findChangedLines
+    (
+        const MarkdownAST *newAst,
+        int editedFirstLine,
+        int editedLastLine,
+        int lineDelta,
+        int firstLine,
+        int lastLine
+    ) const;
+
+    bool hasSameBlockContext
+    (
+        const MarkdownNode *oldNode,
+        int oldLine,
+        const MarkdownNode *newNode,
+        int newLine
+    ) const;
+
+    bool containsReferenceDefinition
+    (
+        const QString &text,
+        const QVector<int> &lineStarts,
+        int firstLine,
+        int lastLine
+    ) const;
+
+    int estimateNodeCount(int textLength) const;
+    QVector<int> indexLines(const QString &text) const;
+    QStringRef lineAt(const QString &text, const QVector<int> &lineStarts, int line) const;
+    bool isBlankLine(const QStringRef &text) const;
+    bool continuesPriorBlock(const QStringRef &text) const;
+};
+
+/**
+ * Thread that runs the parser's request loop.
+ */
+class MarkdownParserThread : public QThread
+{
+public:
+    MarkdownParserThread(MarkdownParserPrivate *parser)
+        : parser(parser)
+    {
+        ;
+    }
+
+protected:
+    void run()
+    {
+        parser->run();
+    }
+
+private:
+    MarkdownParserPrivate *parser;
+};
+
+MarkdownParser::MarkdownParser(QObject *parent)
+    : QObject(parent),
+      d_ptr(new MarkdownParserPrivate(this))
+{
+    Q_D(MarkdownParser);
+
+    qRegisterMetaType<QSharedPointer<MarkdownAST>>();
+    qRegisterMetaType<LineRangeSet>();
+
+    d->requestPending = false;
+    d->textSupplied = false;
+    d->textRequested = false;
+    d->parsing = false;
+    d->reparseRequested = false;
+    d->stopRequested = false;
+    d->htmlRenderingEnabled = false;
+    d->revision = 0;
+    d->referenceDefinitionsFound = false;
+    d->changesUnpublished = false;
+    d->lineStarts.append(0);
+
+    d->referenceDefinitionRegex.setPattern("^ {0,3}\\[[^\\]]+\\]:");
+    d->referenceDefinitionRegex.setPatternOptions(QRegularExpression::MultilineOption);
+    d->setextUnderlineRegex.setPattern("^ {0,3}(=+|-+)\\s*$");
+    d->fenceRegex.setPattern("^ {0,3}(`{3,}|~{3,})(.*)$");
+    d->htmlBlockStartRegex.setPattern("^ {0,3}<(script|pre|style|textarea|!--|\\?|![A-Za-z]|!\\[CDATA\\[)");
+    d->htmlBlockStartRegex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+    d->listItemStartRegex.setPattern("^ {0,3}([*+-]|[0-9]{1,9}[.)])([ \\t]|$)");
+
+    d->thread = new MarkdownParserThread(d);
+    d->thread->start();
+}
+
+MarkdownParser::~MarkdownParser()
+{
+    Q_D(MarkdownParser);
+
+    d->mutex.lock();
+    d->stopRequested = true;
+    d->requestQueued.wakeAll();
+    d->mutex.unlock();
+
+    d->thread->wait();
+    delete d->thread;
+    d->thread = nullptr;
+}
+
+void MarkdownParser::requestParse
+(
+    int firstChangedLine,
+    int lastChangedLine,
+    int lineCount
+)
+{
+    Q_D(MarkdownParser);
+
+    int unchangedHeadLines = qMax(firstChangedLine - 1, 0);
+    int unchangedTailLines = qMax(lineCount - lastChangedLine, 0);
+
+    QMutexLocker locker(&d->mutex);
+
+    // Coalesce with any request that has not yet been picked up.  Any
+    // text already supplied for it no longer includes this change.
+    //
+    if (d->requestPending) {
+        unchangedHeadLines = qMin(unchangedHeadLines, d->request.unchangedHeadLines);
+        unchangedTailLines = qMin(unchangedTailLines, d->request.unchangedTailLines);
+    }
+
+    d->request.text = QString();
+    d->request.unchangedHeadLines = unchangedHeadLines;
+    d->request.unchangedTailLines = unchangedTailLines;
+    d->request.renderHtml = d->htmlRenderingEnabled;
+    d->requestPending = true;
+    d->textSupplied = false;
+    d->reparseRequested = false;
+
+    // Otherwise, the text is requested once the parse in progress is done.
+    if (!d->parsing && !d->textRequested) {
+        d->textRequested = true;
+        emit textRequested();
+    }
+}
+
+void MarkdownParser::setText(int revision, const QString &text)
+{
+    Q_D(MarkdownParser);
+
+    QMutexLocker locker(&d->mutex);
+
+    d->textRequested = false;
+
+    if (!d->requestPending) {
+        return;
+    }
+
+    d->request.revision = revision;
+    d->request.text = text;
+    d->textSupplied = true;
+    d->requestQueued.wakeOne();
+}
+
+void MarkdownParser::requestReparse()
+{
+    Q_D(MarkdownParser);
+
+    QMutexLocker locker(&d->mutex);
+
+    if (!d->requestPending) {
+        d->reparseRequested = true;
+        d->requestQueued.wakeOne();
+    }
+}
+
+void MarkdownParser::setHtmlRenderingEnabled(bool enabled)
+{
+    Q_D(MarkdownParser);
+
+    QMutexLocker locker(&d->mutex);
+
+    d->htmlRenderingEnabled = enabled;
+
+    if (d->requestPending) {
+        d->request.renderHtml = enabled;
+    }
+}
+
+void MarkdownParserPrivate::run()
+{
+    forever {
+        ParseRequest nextRequest;
+        bool reparseNext;
+
+        {
+            QMutexLocker locker(&mutex);
+
+            while
+            (
+                !(requestPending && textSupplied)
+                && !reparseRequested
+                && !stopRequested
+            ) {
+                requestQueued.wait(&mutex);
+            }
+
+            if (stopRequested) {
+                return;
+            }
+
+            // A reparse is only requested while no newer text is queued.
+            reparseNext = reparseRequested;
+            reparseRequested = false;
+
+            if (reparseNext) {
+                nextRequest.renderHtml = htmlRenderingEnabled;
+            } else {
+                nextRequest = request;
+                request.text = QString();
+                requestPending = false;
+                textSupplied = false;
+            }
+
+            parsing = true;
+        }
+
+        if (reparseNext) {
+            reparse(nextRequest.renderHtml);
+        } else {
+            processRequest(nextRequest);
+        }
+
+        {
+            QMutexLocker locker(&mutex);
+
+            parsing = false;
+
+            // Ask for the text of the changes made during the parse.
+            if (requestPending && !textSupplied && !textRequested) {
+                textRequested = true;
+                emit q_ptr->textRequested();
+            }
+        }
+    }
+}
+
+void MarkdownParserPrivate::processRequest(const ParseRequest &parseRequest)
+{
+    QVector<int> newLineStarts = indexLines(parseRequest.text);
+    int lineCount = newLineStarts.size();
+    int lineDelta = lineCount - lineStarts.size();
+    int firstLine = qMin(parseRequest.unchangedHeadLines + 1, lineCount);
+    int lastLine = qMax(lineCount - parseRequest.unchangedTailLines, firstLine);
+    int editedFirstLine = firstLine;
+    int editedLastLine = lastLine;
+    bool allLinesChanged = false;
+    QSharedPointer<MarkdownAST> newAst;
+
+    // Smart typography is enabled for the HTML, as it is for the
+    // preview.  HTML can only be reused for the blocks that are not
+    // re-parsed if it was rendered for the prior AST.
+    //
+    bool smartTypographyEnabled = parseRequest.renderHtml;
+    bool incremental =
+        (!parseRequest.renderHtml || (!ast.isNull() && ast->hasHtml()))
+        && findBlocksToReparse
+        (
+            parseRequest.text,
+            newLineStarts,
+            lineDelta,
+            firstLine,
+            lastLine
+        );
+
+    if (incremental) {
+        int start = newLineStarts[firstLine - 1];
+        int end = parseRequest.text.length();
+
+        if (lastLine < lineCount) {
+            end = newLineStarts[lastLine] - 1;
+        }
+
+        QScopedPointer<MarkdownAST> blocks
+        (
+            CmarkGfmAPI::instance()->parse
+            (
+                parseRequest.text.mid(start, end - start),
+                smartTypographyEnabled,
+                estimateNodeCount(end - start),
+                parseRequest.renderHtml
+            )
+        );
+
+        newAst = QSharedPointer<MarkdownAST>
+        (
+            ast->replaceBlocks
+            (
+                firstLine,
+                lastLine - lineDelta,
+                lineDelta,
+                blocks.data(),
+                parseRequest.text
+            )
+        );
+
+        // The new blocks' HTML cannot be spliced into HTML that was
+        // rendered for the whole document.
+        //
+        if (parseRequest.renderHtml && !newAst->hasHtml()) {
+            incremental = false;
+        }
+    }
+
+    if (!incremental) {
+        bool hadReferenceDefinitions = referenceDefinitionsFound;
+
+        newAst = QSharedPointer<MarkdownAST>
+        (
+            CmarkGfmAPI::instance()->parseInParallel
+            (
+                parseRequest.text,
+                smartTypographyEnabled,
+                estimateNodeCount(parseRequest.text.length()),
+                parseRequest.renderHtml
+            )
+        );
+
+        referenceDefinitionsFound = parseRequest.text.contains(referenceDefinitionRegex);
+
+        // Adding, changing, or removing a link reference definition can
+        // change links anywhere in the document.
+        //
+        if
+        (
+            ast.isNull()
+            || (nullptr == ast->root())
+            ||
+            (
+                (hadReferenceDefinitions || referenceDefinitionsFound)
+                &&
+                (
+                    containsReferenceDefinition(text, lineStarts, firstLine, lastLine - lineDelta)
+                    || containsReferenceDefinition(parseRequest.text, newLineStarts, firstLine, lastLine)
+                )
+            )
+        ) {
+            allLinesChanged = true;
+        } else {
+            findChangedBlocks(newAst.data(), lineCount, lineDelta, firstLine, lastLine);
+        }
+    }
+
+    LineRangeSet changedLines;
+
+    if (allLinesChanged) {
+        changedLines.addRange(1, lineCount);
+    } else {
+        changedLines =
+            findChangedLines
+            (
+                newAst.data(),
+                editedFirstLine,
+                editedLastLine,
+                lineDelta,
+                firstLine,
+                lastLine
+            );
+    }
+
+    if (changesUnpublished) {
+        unpublishedLines.applyEdit
+        (
+            parseRequest.unchangedHeadLines,
+            parseRequest.unchangedTailLines,
+            lineCount,
+            lineDelta
+        );
+        changedLines.unite(unpublishedLines);
+    }
+
+    ast = newAst;
+    revision = parseRequest.revision;
+    text = parseRequest.text;
+    lineStarts = newLineStarts;
+
+    publish(parseRequest.revision, newAst, changedLines);
+}
+
+void MarkdownParserPrivate::reparse(bool renderHtml)
+{
+    if (ast.isNull()) {
+        return;
+    }
+
+    // The text is unchanged, and so are its blocks.  Only the lines
+    // changed by a superseded AST remain to be published.
+    //
+    ast = QSharedPointer<MarkdownAST>
+    (
+        CmarkGfmAPI::instance()->parseInParallel
+        (
+            text,
+            renderHtml,
+            estimateNodeCount(text.length()),
+            renderHtml
+        )
+    );
+
+    LineRangeSet changedLines;
+
+    if (changesUnpublished) {
+        changedLines = unpublishedLines;
+    }
+
+    publish(revision, ast, changedLines);
+}
+
+void MarkdownParserPrivate::publish
+(
+    int astRevision,
+    const QSharedPointer<MarkdownAST> &newAst,
+    const LineRangeSet &changedLines
+)
+{
+    Q_Q(MarkdownParser);
+
+    {
+        QMutexLocker locker(&mutex);
+
+        // Discard the AST if a newer revision is already waiting to be
+        // parsed, but remember which lines it changed.
+        //
+        if (requestPending) {
+            changesUnpublished = true;
+            unpublishedLines = changedLines;
+            return;
+        }
+    }
+
+    changesUnpublished = false;
+    unpublishedLines = LineRangeSet();
+
+    emit q->parsed(astRevision, newAst, changedLines);
+}
+
+bool MarkdownParserPrivate::findBlocksToReparse
+(
+    const QString &newText,
+    const QVector<int> &newLineStarts,
+    int lineDelta,
+    int &firstLine,
+    int &lastLine
+) const
+{
+    // Link reference and footnote definitions affect how text anywhere
+    // in the document is parsed, so always do a full parse if there are
+    // any.
+    //
+    if (ast.isNull() || (nullptr == ast->root()) || referenceDefinitionsFound) {
+        return false;
+    }
+
+    int lineCount = newLineStarts.size();
+    int oldLineCount = lineStarts.size();
+
+    // Typing or removing a setext heading underline changes how the
+    // text above it is parsed.
+    //
+    for (int line = firstLine; line <= lastLine; line++) {
+        if (setextUnderlineRegex.match(lineAt(newText, newLineStarts, line)).hasMatch()) {
+            return false;
+        }
+    }
+
+    bool expanded = true;
+
+    // Grow the changed lines until they enclose whole top-level blocks
+    // from the prior parse and are surrounded by blank lines (or the
+    // start or end of the text).
+    //
+    while (expanded) {
+        expanded = false;
+
+        while ((firstLine > 1) && !isBlankLine(lineAt(newText, newLineStarts, firstLine - 1))) {
+            firstLine--;
+        }
+
+        while ((lastLine < lineCount) && !isBlankLine(lineAt(newText, newLineStarts, lastLine + 1))) {
+            lastLine++;
+        }
+
+        // Lines after the changed text have moved by lineDelta since the
+        // prior parse, whereas those before it have not moved.
+        //
+        int oldLastLine = lastLine - lineDelta;
+        const MarkdownNode *node = ast->root()->firstChild();
+
+        while (nullptr != node) {
+            int endLine = node->endLine();
+
+            if (0 == endLine) {
+                endLine = oldLineCount;
+            }
+
+            if ((node->startLine() <= oldLastLine) && (endLine >= firstLine)) {
+                if (node->startLine() < firstLine) {
+                    firstLine = node->startLine();
+                    expanded = true;
+                }
+
+                int newEndLine = qMin(endLine + lineDelta, lineCount);
+
+                if (newEndLine > lastLine) {
+                    lastLine = newEndLine;
+                    expanded = true;
+                }
+            }
+
+            node = node->next();
+        }
+    }
+
+    // Re-parsing most of the text is no faster than a full parse.
+    if ((lastLine - firstLine + 1) > (lineCount / 2)) {
+        return false;
+    }
+
+    // Make sure the changed blocks can't be continuing a list or indented
+    // code block before them, and that the blocks after them can't be
+    // continuing a list within the changed blocks.
+    //
+    if ((firstLine > 1) && continuesPriorBlock(lineAt(newText, newLineStarts, firstLine))) {
+        return false;
+    }
+
+    int nextLine = lastLine + 1;
+
+    while ((nextLine <= lineCount) && isBlankLine(lineAt(newText, newLineStarts, nextLine))) {
+        nextLine++;
+    }
+
+    if ((nextLine <= lineCount) && continuesPriorBlock(lineAt(newText, newLineStarts, nextLine))) {
+        return false;
+    }
+
+    // Make sure the changed blocks do not contain link reference
+    // definitions or unterminated code fences and HTML blocks, any of
+    // which could change how the text after them is parsed.
+    //
+    QStringRef openFence;
+
+    for (int line = firstLine; line <= lastLine; line++) {
+        QStringRef lineText = lineAt(newText, newLineStarts, line);
+
+        if
+        (
+            referenceDefinitionRegex.match(lineText).hasMatch()
+            || htmlBlockStartRegex.match(lineText).hasMatch()
+        ) {
+            return false;
+        }
+
+        QRegularExpressionMatch match = fenceRegex.match(lineText);
+
+        if (match.hasMatch()) {
+            QStringRef fence = match.capturedRef(1);
+
+            if (openFence.isEmpty()) {
+                // Backtick fences cannot have backticks in their
+                // info strings.
+                if (('~' == fence.at(0)) || !match.capturedRef(2).contains('`')) {
+                    openFence = fence;
+                }
+            } else if
+            (
+                (fence.at(0) == openFence.at(0))
+                && (fence.length() >= openFence.length())
+                && isBlankLine(match.capturedRef(2))
+            ) {
+                openFence = QStringRef();
+            }
+        }
+    }
+
+    return openFence.isEmpty();
+}
+
+void MarkdownParserPrivate::findChangedBlocks
+(
+    const MarkdownAST *newAst,
+    int lineCount,
+    int lineDelta,
+    int &firstLine,
+    int &lastLine
+) const
+{
+    // Compare the top-level blocks of the old and new ASTs from the start
+    // and from the end.  The blocks that differ in type or in which lines
+    // they span, along with the changed lines, are what changed.
+    //
+    const MarkdownNode *oldNode = ast->root()->firstChild();
+    const MarkdownNode *newNode = newAst->root()->firstChild();
+
+    while
+    (
+        (nullptr != oldNode)
+        && (nullptr != newNode)
+        && (oldNode->type() == newNode->type())
+        && (oldNode->startLine() == newNode->startLine())
+        && (oldNode->endLine() == newNode->endLine())
+    ) {
+        oldNode = oldNode->next();
+        newNode = newNode->next();
+    }
+
+    if (nullptr != newNode) {
+        firstLine = qMin(firstLine, newNode->startLine());
+    } else if (nullptr != oldNode) {
+        firstLine = qMin(firstLine, qMax(oldNode->startLine(), 1));
+    }
+
+    oldNode = ast->root()->lastChild();
+    newNode = newAst->root()->lastChild();
+
+    while
+    (
+        (nullptr != oldNode)
+        && (nullptr != newNode)
+        && (oldNode->type() == newNode->type())
+        && ((oldNode->startLine() + lineDelta) == newNode->startLine())
+        && ((oldNode->endLine() + lineDelta) == newNode->endLine())
+    ) {
+        oldNode = oldNode->previous();
+        newNode = newNode->previous();
+    }
+
+    if (nullptr != newNode) {
+        int endLine = newNode->endLine();
+
+        if ((0 == endLine) || (endLine > lineCount)) {
+            endLine = lineCount;
+        }
+
+        lastLine = qMax(lastLine, endLine);
+    } else if (nullptr != oldNode) {
+        lastLine = qMax(lastLine, qMin(oldNode->endLine() + lineDelta, lineCount));
+    }
+
+    firstLine = qMax(qMin(firstLine, lastLine), 1);
+}
+
+LineRangeSet MarkdownParserPrivate::findChangedLines
+(
+    const MarkdownAST *newAst,
+    int editedFirstLine,
+    int editedLastLine,
+    int lineDelta,
+    int firstLine,
+    int lastLine
+) const
+{
+    LineRangeSet changedLines;
+
+    // Lines between firstLine and lastLine that were not edited map
+    // back to the lines of the prior text before and after the edit.
+    //
+    QVector<MarkdownNode *> oldBlocks = ast->findBlocksInLineRange(firstLine, lastLine - lineDelta);
+    QVector<MarkdownNode *> newBlocks = newAst->findBlocksInLineRange(firstLine, lastLine);
+
+    for (int line = firstLine; line <= lastLine; line++) {
+        if ((line >= editedFirstLine) && (line <= editedLastLine)) {
+            changedLines.addRange(line, line);
+            continue;
+        }
+
+        int oldLine = line;
+
+        if (line > editedLastLine) {
+            oldLine -= lineDelta;
+        }
+
+        const MarkdownNode *oldNode = oldBlocks.value(oldLine - firstLine, nullptr);
+        const MarkdownNode *newNode = newBlocks.value(line - firstLine, nullptr);
+
+        if (!hasSameBlockContext(oldNode, oldLine, newNode, line)) {
+            changedLines.addRange(line, line);
+            continue;
+        }
+
+        // Inline nodes, such as emphasis, can span the lines of the
+        // block that holds them, so an edit to one line of a block can
+        // change how its other lines are formatted.  Only code and HTML
+        // blocks are left as they are, since they have no inline nodes.
+        //
+        if
+        (
+            (nullptr != newNode)
+            && (MarkdownNode::CodeBlock != newNode->type())
+            && (MarkdownNode::HtmlBlock != newNode->type())
+            && (newNode->startLine() <= editedLastLine)
+            && ((newNode->endLine() >= editedFirstLine) || (0 == newNode->endLine()))
+        ) {
+            changedLines.addRange(line, line);
+        }
+    }
+
+    return changedLines;
+}
+
+bool MarkdownParserPrivate::hasSameBlockContext
+(
+    const MarkdownNode *oldNode,
+    int oldLine,
+    const MarkdownNode *newNode,
+    int newLine
+) const
+{
+    // A line is formatted by its innermost block and the blocks that
+    // contain it, in light of whether the line begins or ends each of
+    // them.  Setext headings and pipe tables, for example, change the
+    // context of the lines above the one that was edited.
+    //
+    while ((nullptr != oldNode) && (nullptr != newNode)) {
+        if
+        (
+            (oldNode->type() != newNode->type())
+            || (oldNode->headingLevel() != newNode->headingLevel())
+            || (oldNode->isFencedCodeBlock() != newNode->isFencedCodeBlock())
+            || ((oldNode->length() <= 0) != (newNode->length() <= 0))
+            || ((oldNode->startLine() == oldLine) != (newNode->startLine() == newLine))
+            || ((oldNode->endLine() == oldLine) != (newNode->endLine() == newLine))
+            || ((0 == oldNode->endLine()) != (0 == newNode->endLine()))
+        ) {
+            return false;
+        }
+
+        oldNode = oldNode->parent();
+        newNode = newNode->parent();
+    }
+
+    return (nullptr == oldNode) && (nullptr == newNode);
+}
+
+bool MarkdownParserPrivate::containsReferenceDefinition
+(
+    const QString &text,
+    const QVector<int> &lineStarts,
+    int firstLine,
+    int lastLine
+) const
+{
+    firstLine = qMax(firstLine, 1);
+    lastLine = qMin(lastLine, lineStarts.size());
+
+    for (int line = firstLine; line <= lastLine; line++) {
+        if (referenceDefinitionRegex.match(lineAt(text, lineStarts, line)).hasMatch()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int MarkdownParserPrivate::estimateNodeCount(int textLength) const
+{
+    if (ast.isNull() || text.isEmpty()) {
+        return 0;
+    }
+
+    // Assume the text has the same density of nodes as the prior
+    // revision, plus some room to grow, so that the new AST's storage
+    // is allocated only once.
+    //
+    qint64 estimate = ((qint64) ast->nodeCount() * textLength) / text.length();
+
+    return (int) qMin(estimate + (estimate / 8) + 16, (qint64) std::numeric_limits<int>::max());
+}
+
+QVector<int> MarkdownParserPrivate::indexLines(const QString &text) const
+{
+    QVector<int> starts;
+    starts.append(0);
+
+    for (int i = 0; i < text.length(); i++) {
+        if ('\n' == text[i]) {
+            starts.append(i + 1);
+        }
+    }
+
+    return starts;
+}
+
+QStringRef MarkdownParserPrivate::lineAt
+(
+    const QString &text,
+    const QVector<int> &lineStarts,
+    int line
+) const
+{
+    int start = lineStarts[line - 1];
+    int end = text.length();
+
+    if (line < lineStarts.size()) {
+        end = lineStarts[line] - 1;
+    }
+
+    return text.midRef(start, end - start);
+}
+
+bool MarkdownParserPrivate::isBlankLine(const QStringRef &text) const
+{
+    for (int i = 0; i < text.length(); i++) {
+        if ((' ' != text.at(i)) && ('\t' != text.at(i))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MarkdownParserPrivate::continuesPriorBlock(const QStringRef &text) const
+{
+    return
+        (
+            (!text.isEmpty() && ((' ' == text.at(0)) || ('\t' == text.at(0))))
+            || listItemStartRegex.match(text).hasMatch()
+        );
+}
+} // namespace ghostwriter
@@ -0,0 +1,126 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef MARKDOWN_PARSER_H
+#define MARKDOWN_PARSER_H
+
+#include <QMetaType>
+#include <QObject>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QString>
+
+#include "linerangeset.h"
+#include "markdownast.h"
+
+namespace ghostwriter
+{
+/**
+ * Parses Markdown text on a background thread, publishing an immutable
+ * AST snapshot for each revision of the text.  Requests for new
+ * revisions that arrive while a parse is in progress are coalesced,
+ * such that only the latest revision is parsed next.  The text itself
+ * is only requested once the parser is ready to parse it, so that the
+ * text is copied at most once per parse no matter how many changes were
+ * coalesced.  When possible, only the blocks of text that changed since
+ * the prior revision are re-parsed.
+ */
+class MarkdownParserPrivate;
+class MarkdownParser : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(MarkdownParser)
+
+public:
+    /**
+     * Constructor.
+     */
+    MarkdownParser(QObject *parent = nullptr);
+
+    /**
+     * Destructor.  Waits for any parse in progress to finish.
+     */
+    ~MarkdownParser();
+
+    /**
+     * Queues the Markdown text to be parsed again.  The first and last
+     * changed lines (inclusive) give the range of lines that have changed
+     * since the prior call, and the line count is that of the text after
+     * the change.  Emits textRequested() once the parser is ready for the
+     * text, unless it has already been requested.
+     */
+    void requestParse(int firstChangedLine, int lastChangedLine, int lineCount);
+
+    /**
+     * Sets the text to parse in answer to textRequested(), along with its
+     * revision.  The text must include all of the changes queued with
+     * requestParse() so far, and revision numbers must increase with
+     * each call.
+     */
+    void setText(int revision, const QString &text);
+
+    /**
+     * Queues the most recently parsed text to be parsed again with the
+     * current settings, such as after HTML rendering is enabled.  The
+     * AST is emitted with the same revision as before, and without any
+     * changed lines.  Does nothing if a parse of newer text is queued,
+     * since that parse already uses the current settings.
+     */
+    void requestReparse();
+
+    /**
+     * Sets whether HTML is rendered into the AST of each revision, such
+     * as for the HTML preview.  Rendering applies to the revisions queued
+     * after this call, along with any revision still waiting to be parsed.
+     */
+    void setHtmlRenderingEnabled(bool enabled);
+
+signals:
+    /**
+     * Emitted when the parser is ready to parse the text queued with
+     * requestParse(), which is to be given to setText().  This may be
+     * emitted from the parser thread, or from the thread calling
+     * requestParse() while the parser is idle, so connect to it with a
+     * queued connection for changes made in the meantime to be coalesced.
+     */
+    void textRequested();
+
+    /**
+     * Emitted from the parser thread when the given revision of the
+     * text has been parsed.  The changed lines are those that were edited
+     * since the previously emitted AST, along with those whose blocks
+     * (or the lines they span) differ from those of the previously
+     * emitted AST.  Revisions that were superseded by a newer request
+     * before their parse completed are not emitted.
+     */
+    void parsed
+    (
+        int revision,
+        QSharedPointer<MarkdownAST> ast,
+        const LineRangeSet &changedLines
+    );
+
+private:
+    QScopedPointer<MarkdownParserPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+Q_DECLARE_METATYPE(QSharedPointer<ghostwriter::MarkdownAST>)
+
+#endif
@@ -108,9 +108,9 @@ OutlineWidget::OutlineWidget(MarkdownEditor *editor, QWidget *parent)
 
     this->connect
     (
-        editor->document(),
-        &MarkdownDocument::contentsChange,
-        [d](int, int, int) {
+        (MarkdownDocument *) editor->document(),
+        &MarkdownDocument::markdownASTChanged,
+        [d]() {
             d->reloadOutline();
         }
     );
@@ -205,9 +205,9 @@ void OutlineWidgetPrivate::reloadOutline()
         return;
     }
 
-    MarkdownAST *ast = ((MarkdownDocument *) editor->document())->markdownAST();
+    QSharedPointer<MarkdownAST> ast = ((MarkdownDocument *) editor->document())->markdownAST();
 
-    if (nullptr == ast) {
+    if (ast.isNull()) {
         return;
     }
 
@@ -20,6 +20,8 @@
 #ifndef ABSTRACT_DICTIONARY_H
 #define ABSTRACT_DICTIONARY_H
 
+#include <QMutex>
+
 class QString;
 class QStringList;
 class QStringRef;
@@ -36,6 +38,17 @@ public:
 	virtual void addToPersonal(const QString& word) = 0;
 	virtual void addToSession(const QStringList& words) = 0;
 	virtual void removeFromSession(const QStringList& words) = 0;
+
+	// Dictionaries may be checked from background threads, so checks and
+	// suggestions are serialized with changes to each dictionary through
+	// its own lock.
+	QMutex* lock() const
+	{
+		return &m_lock;
+	}
+
+private:
+	mutable QMutex m_lock;
 };
 
 #endif
@@ -29,7 +29,11 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFutureWatcher>
+#include <QMutexLocker>
+#include <QSet>
 #include <QTextStream>
+#include <QtConcurrentRun>
 
 #include <algorithm>
 
@@ -186,12 +190,14 @@ DictionaryRef DictionaryManager::requestDictionary(const QString& language)
 	if (language.isEmpty()) {
 		// Fetch shared default dictionary
 		if (!m_default_dictionary) {
-			m_default_dictionary = *requestDictionaryData(m_default_language);
+			AbstractDictionary* dictionary = *requestDictionaryData(m_default_language);
+			QMutexLocker locker(&m_lock);
+			m_default_dictionary = dictionary;
 		}
-		return &m_default_dictionary;
+		return DictionaryRef(&m_default_dictionary, &m_lock);
 	} else {
 		// Fetch specific dictionary
-		return requestDictionaryData(language);
+		return DictionaryRef(requestDictionaryData(language), &m_lock);
 	}
 }
 
@@ -204,7 +210,11 @@ void DictionaryManager::setDefaultLanguage(const QString& language)
 	}
 
 	m_default_language = language;
-	m_default_dictionary = *requestDictionaryData(m_default_language);
+	AbstractDictionary* dictionary = *requestDictionaryData(m_default_language);
+	{
+		QMutexLocker locker(&m_lock);
+		m_default_dictionary = dictionary;
+	}
 
 	// Re-check documents
 	emit changed();
@@ -263,9 +273,19 @@ void DictionaryManager::setPersonal(const QStringList& words)
 		return;
 	}
 
-	// Remove current personal dictionary
+	// Only remove and add the words that changed, so that dictionaries
+	// keep their cached spellings of the rest
+	QSet<QString> old_words(m_personal.begin(), m_personal.end());
+	QSet<QString> new_words(personal.begin(), personal.end());
+	QSet<QString> removed_words = old_words - new_words;
+	QSet<QString> added_words = new_words - old_words;
+	QStringList removed(removed_words.begin(), removed_words.end());
+	QStringList added(added_words.begin(), added_words.end());
+
+	// Remove words no longer in personal dictionary
 	foreach (AbstractDictionary* dictionary, m_dictionaries) {
-		dictionary->removeFromSession(m_personal);
+		QMutexLocker locker(dictionary->lock());
+		dictionary->removeFromSession(removed);
 	}
 
 	// Update and store personal dictionary
@@ -279,9 +299,10 @@ void DictionaryManager::setPersonal(const QStringList& words)
 		}
 	}
 
-	// Add personal dictionary
+	// Add words new to personal dictionary
 	foreach (AbstractDictionary* dictionary, m_dictionaries) {
-		dictionary->addToSession(m_personal);
+		QMutexLocker locker(dictionary->lock());
+		dictionary->addToSession(added);
 	}
 
 	// Re-check documents
@@ -290,8 +311,11 @@ void DictionaryManager::setPersonal(const QStringList& words)
 
 //-----------------------------------------------------------------------------
 
-DictionaryManager::DictionaryManager()
+DictionaryManager::DictionaryManager() :
+	m_default_dictionary(0)
 {
+	m_loader.setMaxThreadCount(1);
+
 	addProviders();
 
 	// Load personal dictionary
@@ -310,8 +334,12 @@ DictionaryManager::DictionaryManager()
 
 DictionaryManager::~DictionaryManager()
 {
+	m_loader.waitForDone();
+
 	foreach (AbstractDictionary* dictionary, m_dictionaries) {
-		delete dictionary;
+		if (dictionary != *DictionaryFallback::instance()) {
+			delete dictionary;
+		}
 	}
 	m_dictionaries.clear();
 
@@ -336,24 +364,72 @@ void DictionaryManager::addProvider(AbstractDictionaryProvider* provider)
 AbstractDictionary** DictionaryManager::requestDictionaryData(const QString& language)
 {
 	if (!m_dictionaries.contains(language)) {
-		AbstractDictionary* dictionary = 0;
-		foreach (AbstractDictionaryProvider* provider, m_providers) {
-			dictionary = provider->requestDictionary(language);
+		// Use fallback until dictionary is loaded
+		QMutexLocker locker(&m_lock);
+		m_dictionaries[language] = *DictionaryFallback::instance();
+		locker.unlock();
+
+		loadDictionary(language);
+	} else if ((m_dictionaries[language] == *DictionaryFallback::instance()) && !m_loading.contains(language)) {
+		// Try again in case dictionary has since been installed
+		loadDictionary(language);
+	}
+	return &m_dictionaries[language];
+}
+
+//-----------------------------------------------------------------------------
+
+void DictionaryManager::loadDictionary(const QString& language)
+{
+	bool was_loading = isLoading();
+	m_loading.insert(language);
+	if (!was_loading) {
+		emit loadingStarted();
+	}
+
+	QFutureWatcher<AbstractDictionary*>* watcher = new QFutureWatcher<AbstractDictionary*>(this);
+	connect(watcher, &QFutureWatcher<AbstractDictionary*>::finished, this, [this, watcher, language]() {
+		dictionaryLoaded(language, watcher->result());
+		watcher->deleteLater();
+	});
+
+	QList<AbstractDictionaryProvider*> providers = m_providers;
+	watcher->setFuture(QtConcurrent::run(&m_loader, [providers, language]() -> AbstractDictionary* {
+		foreach (AbstractDictionaryProvider* provider, providers) {
+			AbstractDictionary* dictionary = provider->requestDictionary(language);
 			if (dictionary && dictionary->isValid()) {
-				break;
-			} else {
-				delete dictionary;
-				dictionary = 0;
+				return dictionary;
 			}
+			delete dictionary;
 		}
+		return 0;
+	}));
+}
 
-		if (!dictionary) {
-			return DictionaryFallback::instance();
-		}
+//-----------------------------------------------------------------------------
+
+void DictionaryManager::dictionaryLoaded(const QString& language, AbstractDictionary* dictionary)
+{
+	m_loading.remove(language);
+
+	// Replace fallback, which stays in place if no provider has the language
+	if (dictionary) {
 		dictionary->addToSession(m_personal);
+		QMutexLocker locker(&m_lock);
 		m_dictionaries[language] = dictionary;
+		if (language == m_default_language) {
+			m_default_dictionary = dictionary;
+		}
+	}
+
+	if (!isLoading()) {
+		emit loadingFinished();
+	}
+
+	// Re-check documents
+	if (dictionary) {
+		emit changed();
 	}
-	return &m_dictionaries[language];
 }
 
 //-----------------------------------------------------------------------------
@@ -25,8 +25,11 @@ class AbstractDictionaryProvider;
 class DictionaryRef;
 
 #include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
+#include <QThreadPool>
 
 class DictionaryManager : public QObject
 {
@@ -39,6 +42,7 @@ public:
 	QString availableDictionary(const QString& language) const;
 	QString defaultLanguage() const;
 	QStringList personal() const;
+	bool isLoading() const;
 
 	void add(const QString& word);
 	void addProviders();
@@ -54,6 +58,8 @@ public:
 
 signals:
 	void changed();
+	void loadingStarted();
+	void loadingFinished();
 
 private:
 	DictionaryManager();
@@ -61,11 +67,19 @@ private:
 
 	void addProvider(AbstractDictionaryProvider* provider);
 	AbstractDictionary** requestDictionaryData(const QString& language);
+	void loadDictionary(const QString& language);
+	void dictionaryLoaded(const QString& language, AbstractDictionary* dictionary);
 
 private:
 	QList<AbstractDictionaryProvider*> m_providers;
 	QHash<QString, AbstractDictionary*> m_dictionaries;
 	AbstractDictionary* m_default_dictionary;
+	QMutex m_lock;
+
+	// Dictionaries are loaded in the background, during which the
+	// fallback dictionary takes their place.
+	QThreadPool m_loader;
+	QSet<QString> m_loading;
 
 	QString m_default_language;
 	QStringList m_personal;
@@ -78,6 +92,11 @@ inline QString DictionaryManager::defaultLanguage() const
 	return m_default_language;
 }
 
+inline bool DictionaryManager::isLoading() const
+{
+	return !m_loading.isEmpty();
+}
+
 inline QString DictionaryManager::path()
 {
 	return m_path;
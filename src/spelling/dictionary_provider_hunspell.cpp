@@ -22,12 +22,15 @@
 
 #include "abstract_dictionary.h"
 #include "dictionary_manager.h"
+#include "wordtokenizer.h"
 
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QListIterator>
 #include <QRegExp>
+#include <QSet>
 #include <QStringList>
 #include <QTextCodec>
 
@@ -44,6 +47,9 @@ static bool f_ignore_uppercase = true;
 
 //-----------------------------------------------------------------------------
 
+using ghostwriter::WordToken;
+using ghostwriter::WordTokenizer;
+
 namespace
 {
 
@@ -65,9 +71,26 @@ public:
 	void addToSession(const QStringList& words);
 	void removeFromSession(const QStringList& words);
 
+private:
+	bool spell(const QString& word) const;
+	void forgetVerdicts(const QStringList& words, bool verdict);
+
 private:
 	Hunspell* m_dictionary;
 	QTextCodec* m_codec;
+
+	// Verdicts of words already looked up, so that the words repeated
+	// throughout a document are only encoded and spelled by Hunspell
+	// once.  When the current verdicts fill up, they replace the prior
+	// ones, and verdicts found in the prior ones are carried over.  Words
+	// added to the session are checked apart from the verdicts, so that
+	// adding and removing them only forgets the verdicts they change.
+	// Access is serialized by the lock of the dictionary.
+	//
+	static const int MaxCachedVerdicts = 16384;
+	mutable QHash<QString, bool> m_verdicts;
+	mutable QHash<QString, bool> m_prior_verdicts;
+	QSet<QString> m_session;
 };
 
 //-----------------------------------------------------------------------------
@@ -116,127 +139,25 @@ DictionaryHunspell::~DictionaryHunspell()
 
 QStringRef DictionaryHunspell::check(const QString& string, int start_at) const
 {
-    // Incorporated ghostwriter's word splitting algorithm into the original
-    // FocusWriter algorithm to ensure hyphenated words are counted as one
-    // word.
-
-    bool inWord = false;
-    int separatorCount = 0;
-    int wordLen = 0;
-    bool isNumber = false;
-    bool isUppercase = f_ignore_uppercase;
-    bool isWord = false;
-    int index = -1;
-
-    for (int i = start_at; i < string.length(); i++)
-    {
-        QChar c = string.at(i);
-
-        if (c.isLetterOrNumber() || c.isMark())
-        {
-            inWord = true;
-            separatorCount = 0;
-            wordLen++;
-
-            if (index < 0)
-            {
-                index = i;
-            }
-
-            if (c.isNumber())
-            {
-                isNumber = f_ignore_numbers;
-            }
-            else if (c.isLower())
-            {
-                isUppercase = false;
-            }
-        }
-        else if (c.isSpace() && inWord)
-        {
-            inWord = false;
-            isWord = true;
-
-            if (separatorCount > 0)
-            {
-                wordLen--;
-            }
-        }
-        else
-        {
-            // This is to handle things like double dashes (`--`)
-            // that separate words, while still counting hyphenated
-            // words as a single word.
-            //
-            separatorCount++;
-
-            if (inWord)
-            {
-                // Only count dashes (`-`), periods (`.`) and single
-                // quotation marks (`'`) as separators that can be
-                // used inside a single word.
-                //
-                if
-                (
-                    (1 == separatorCount) &&
-                    (QChar('-') != c) &&
-                    (QChar('.') != c) &&
-                    (QChar('\'') != c)
-                )
-                {
-                    separatorCount = 0;
-                    inWord = false;
-                    isWord = true;
-                }
-                else if (separatorCount > 1)
-                {
-                    separatorCount = 0;
-                    inWord = false;
-                    isWord = true;
-                    wordLen--;
-                }
-                else
-                {
-                    wordLen++;
-                }
-            }
-        }
-
-        if (inWord && ((string.length() - 1) == i))
-        {
-            isWord = true;
-
-            if (separatorCount > 0)
-            {
-                wordLen--;
-            }
-        }
-
-        if (isWord && (index >= 0))
-        {
-            if (!isUppercase && !isNumber)
-            {
-                QStringRef check(&string, index, wordLen);
-                QString word = check.toString();
-
-                // Replace any fancy single quotes with a "normal" single quote.
-                word.replace(QChar(0x2019), QLatin1Char('\''));
-
-                if (!m_dictionary->spell(m_codec->fromUnicode(word).constData()))
-                {
-                    return check;
-                }
-            }
-
-            index = -1;
-            wordLen = 0;
-            separatorCount = 0;
-            isWord = false;
-            inWord = false;
-            isNumber = false;
-            isUppercase = f_ignore_uppercase;
-        }
-    }
+	WordTokenizer tokenizer(string, start_at);
+	WordToken token;
+
+	while (tokenizer.next(token)) {
+		if ((f_ignore_numbers && (token.flags & WordTokenizer::NumberFlag)) ||
+				(f_ignore_uppercase && !(token.flags & WordTokenizer::LowercaseFlag))) {
+			continue;
+		}
+
+		QStringRef check(&string, token.position, token.length);
+		QString word = check.toString();
+
+		// Replace any fancy single quotes with a "normal" single quote.
+		word.replace(QChar(0x2019), QLatin1Char('\''));
+
+		if (!spell(word)) {
+			return check;
+		}
+	}
 
 	return QStringRef();
 }
@@ -284,7 +205,11 @@ void DictionaryHunspell::addToSession(const QStringList& words)
 #else
 		m_dictionary->add(m_codec->fromUnicode(word).toStdString());
 #endif
+		m_session.insert(word);
 	}
+
+	// Only misspellings can be corrected by added words.
+	forgetVerdicts(words, false);
 }
 
 //-----------------------------------------------------------------------------
@@ -297,7 +222,69 @@ void DictionaryHunspell::removeFromSession(const QStringList& words)
 #else
 		m_dictionary->remove(m_codec->fromUnicode(word).toStdString());
 #endif
+		m_session.remove(word);
+	}
+
+	// Only correct spellings can be undone by removed words.
+	forgetVerdicts(words, true);
+}
+
+//-----------------------------------------------------------------------------
+
+bool DictionaryHunspell::spell(const QString& word) const
+{
+	if (m_session.contains(word)) {
+		return true;
+	}
 
+	QHash<QString, bool>::const_iterator verdict = m_verdicts.constFind(word);
+	if (verdict != m_verdicts.constEnd()) {
+		return verdict.value();
+	}
+
+	bool correct;
+
+	verdict = m_prior_verdicts.constFind(word);
+	if (verdict != m_prior_verdicts.constEnd()) {
+		correct = verdict.value();
+	} else {
+		correct = m_dictionary->spell(m_codec->fromUnicode(word).constData());
+	}
+
+	if (m_verdicts.size() >= MaxCachedVerdicts) {
+		m_prior_verdicts.swap(m_verdicts);
+		m_verdicts.clear();
+	}
+	m_verdicts.insert(word, correct);
+
+	return correct;
+}
+
+//-----------------------------------------------------------------------------
+
+void DictionaryHunspell::forgetVerdicts(const QStringList& words, bool verdict)
+{
+	if (words.isEmpty()) {
+		return;
+	}
+
+	// Hunspell accepts capitalized forms of the words in its dictionary,
+	// so compare the cached words without case.
+	QSet<QString> folded;
+	foreach (const QString& word, words) {
+		folded.insert(word.toCaseFolded());
+	}
+
+	QHash<QString, bool>* caches[] = { &m_verdicts, &m_prior_verdicts };
+	for (QHash<QString, bool>* cache : caches) {
+		QHash<QString, bool>::iterator i = cache->begin();
+		while (i != cache->end()) {
+			if ((i.value() == verdict) && folded.contains(i.key().toCaseFolded())) {
+				i = cache->erase(i);
+			} else {
+				++i;
+			}
+		}
 	}
 }
 
@@ -23,20 +23,30 @@
 #include "abstract_dictionary.h"
 class DictionaryManager;
 
+#include <QMutex>
+#include <QMutexLocker>
 #include <QStringList>
 #include <QStringRef>
 
+// Dictionaries may be checked from background threads.  The lock shared
+// by all references only guards which dictionary a reference points to,
+// so that a slow check or suggestion holds the lock of its dictionary
+// alone.  Dictionaries are never deleted while references to them exist.
 class DictionaryRef
 {
 public:
 	QStringRef check(const QString& string, int start_at) const
 	{
-		return (*d)->check(string, start_at);
+		AbstractDictionary* dictionary = data();
+		QMutexLocker locker(dictionary->lock());
+		return dictionary->check(string, start_at);
 	}
 
 	QStringList suggestions(const QString& word) const
 	{
-		return (*d)->suggestions(word);
+		AbstractDictionary* dictionary = data();
+		QMutexLocker locker(dictionary->lock());
+		return dictionary->suggestions(word);
 	}
 
 	void addToPersonal(const QString& word)
@@ -47,14 +57,23 @@ public:
 	friend class DictionaryManager;
 
 private:
-	DictionaryRef(AbstractDictionary** data) :
-		d(data)
+	DictionaryRef(AbstractDictionary** data, QMutex* lock) :
+		d(data),
+		m_lock(lock)
 	{
 		Q_ASSERT(d != 0);
+		Q_ASSERT(m_lock != 0);
+	}
+
+	AbstractDictionary* data() const
+	{
+		QMutexLocker locker(m_lock);
+		return *d;
 	}
 
 private:
 	AbstractDictionary** d;
+	QMutex* m_lock;
 };
 
 #endif
@@ -21,6 +21,7 @@
 #include "spell_checker.h"
 
 #include "dictionary_ref.h"
+#include "backgroundspellchecker.h"
 
 #include <QAction>
 #include <QDialogButtonBox>
@@ -36,13 +37,12 @@
 #include <QTextBlock>
 #include <QPlainTextEdit>
 #include <QTextEdit>
-#include <QSyntaxHighlighter>
 
 //-----------------------------------------------------------------------------
 
-void SpellChecker::checkDocument(QPlainTextEdit* document, QSyntaxHighlighter* spelling_highlighter, DictionaryRef& dictionary)
+void SpellChecker::checkDocument(QPlainTextEdit* document, DictionaryRef& dictionary, ghostwriter::BackgroundSpellChecker* suggester)
 {
-    SpellChecker* checker = new SpellChecker(document, spelling_highlighter, dictionary);
+    SpellChecker* checker = new SpellChecker(document, dictionary, suggester);
 	checker->m_start_cursor = document->textCursor();
 	checker->m_cursor = checker->m_start_cursor;
 	checker->m_cursor.movePosition(QTextCursor::StartOfBlock);
@@ -70,15 +70,19 @@ void SpellChecker::suggestionChanged(QListWidgetItem* suggestion)
 
 //-----------------------------------------------------------------------------
 
-void SpellChecker::add()
+void SpellChecker::suggestionsReady(const QString& word, const QStringList& suggestions)
 {
-    m_dictionary.addToPersonal(m_word);
+	// Ignore suggestions for words that have since been skipped
+	if ((word == m_word) && (m_suggestions->count() == 1) && !(m_suggestions->item(0)->flags() & Qt::ItemIsEnabled)) {
+		showSuggestions(suggestions);
+	}
+}
 
-    if (nullptr != m_spelling_highlighter)
-    {
-        m_spelling_highlighter->rehighlight();
-    }
+//-----------------------------------------------------------------------------
 
+void SpellChecker::add()
+{
+    m_dictionary.addToPersonal(m_word);
 	ignore();
 }
 
@@ -127,11 +131,11 @@ void SpellChecker::changeAll()
 
 //-----------------------------------------------------------------------------
 
-SpellChecker::SpellChecker(QPlainTextEdit* document, QSyntaxHighlighter* spelling_highlighter, DictionaryRef& dictionary) :
+SpellChecker::SpellChecker(QPlainTextEdit* document, DictionaryRef& dictionary, ghostwriter::BackgroundSpellChecker* suggester) :
 	QDialog(document->parentWidget(), Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowCloseButtonHint),
 	m_dictionary(dictionary),
 	m_document(document),
-    m_spelling_highlighter(spelling_highlighter),
+	m_suggester(suggester),
 	m_checked_blocks(1),
 	m_total_blocks(document->document()->blockCount()),
 	m_loop_available(true)
@@ -193,6 +197,11 @@ SpellChecker::SpellChecker(QPlainTextEdit* document, QSyntaxHighlighter* spellin
 
 	layout->setRowMinimumHeight(7, 12);
 	layout->addWidget(buttons, 8, 3);
+
+	// Find suggestions off of the GUI thread if possible
+	if (m_suggester) {
+		connect(m_suggester, &ghostwriter::BackgroundSpellChecker::suggestionsReady, this, &SpellChecker::suggestionsReady);
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -267,15 +276,17 @@ void SpellChecker::check()
 			context = "<p>" + context + "</p>";
             m_context->setHtml(context);
 
-			// Show suggestions
+			// Show suggestions, or wait for them to be found
 			m_suggestion->clear();
 			m_suggestions->clear();
-			QStringList words = m_dictionary.suggestions(m_word);
-			if (!words.isEmpty()) {
-				foreach (const QString& word, words) {
-					m_suggestions->addItem(word);
-				}
-				m_suggestions->setCurrentRow(0);
+			QStringList words;
+			if (!m_suggester) {
+				showSuggestions(m_dictionary.suggestions(m_word));
+			} else if (m_suggester->suggestions(m_word, words, 100)) {
+				showSuggestions(words);
+			} else {
+				QListWidgetItem* item = new QListWidgetItem(tr("Finding suggestions..."), m_suggestions);
+				item->setFlags(Qt::NoItemFlags);
 			}
 
 			// Stop checking words
@@ -294,3 +305,16 @@ void SpellChecker::check()
 }
 
 //-----------------------------------------------------------------------------
+
+void SpellChecker::showSuggestions(const QStringList& suggestions)
+{
+	m_suggestions->clear();
+	if (!suggestions.isEmpty()) {
+		foreach (const QString& word, suggestions) {
+			m_suggestions->addItem(word);
+		}
+		m_suggestions->setCurrentRow(0);
+	}
+}
+
+//-----------------------------------------------------------------------------
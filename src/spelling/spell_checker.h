@@ -22,6 +22,10 @@
 #define SPELL_H
 
 class DictionaryRef;
+namespace ghostwriter
+{
+class BackgroundSpellChecker;
+}
 
 #include <QDialog>
 #include <QTextCursor>
@@ -31,14 +35,13 @@ class QListWidget;
 class QListWidgetItem;
 class QPlainTextEdit;
 class QTextEdit;
-class QSyntaxHighlighter;
 
 class SpellChecker : public QDialog
 {
 	Q_OBJECT
 
 public:
-    static void checkDocument(QPlainTextEdit* document, QSyntaxHighlighter* spelling_highlighter, DictionaryRef& dictionary);
+    static void checkDocument(QPlainTextEdit* document, DictionaryRef& dictionary, ghostwriter::BackgroundSpellChecker* suggester = 0);
 
 public slots:
 	virtual void reject();
@@ -50,16 +53,18 @@ private slots:
 	void ignoreAll();
 	void change();
 	void changeAll();
+	void suggestionsReady(const QString& word, const QStringList& suggestions);
 
 private:
-    SpellChecker(QPlainTextEdit* document, QSyntaxHighlighter* spelling_highlighter, DictionaryRef& dictionary);
+    SpellChecker(QPlainTextEdit* document, DictionaryRef& dictionary, ghostwriter::BackgroundSpellChecker* suggester);
 	void check();
+	void showSuggestions(const QStringList& suggestions);
 
 private:
 	DictionaryRef& m_dictionary;
 
     QPlainTextEdit* m_document;
-    QSyntaxHighlighter* m_spelling_highlighter;
+	ghostwriter::BackgroundSpellChecker* m_suggester;
     QTextEdit* m_context;
 	QLineEdit* m_suggestion;
 	QListWidget* m_suggestions;
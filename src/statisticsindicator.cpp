@@ -59,94 +59,31 @@ StatisticsIndicator::StatisticsIndicator(DocumentStatistics *documentStats,
     int index = 0;
 
     this->addItem(wordCountText(0));
-    this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
-    this->connect(documentStats,
-        &DocumentStatistics::wordCountChanged,
-        this,
-        [this, index](int value) {
-            this->setItemText(index,
-                wordCountText(value));
-
-            if (index == this->currentIndex()) {
-                this->setMinimumContentsLength(this->itemText(index).length());
-            }
-        });
-    index++;
-
     this->addItem(characterCountText(0));
-    this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
-    this->connect(documentStats,
-        &DocumentStatistics::characterCountChanged,
-        this,
-        [this, index](int value) {
-            this->setItemText(index,
-                characterCountText(value));
-
-            if (index == this->currentIndex()) {
-                this->setMinimumContentsLength(this->itemText(index).length());
-            }
-        });
-    index++;
-
     this->addItem(sentenceCountText(0));
-    this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
-    this->connect(documentStats,
-        &DocumentStatistics::sentenceCountChanged,
-        this,
-        [this, index](int value) {
-            this->setItemText(index,
-                sentenceCountText(value));
-
-            if (index == this->currentIndex()) {
-                this->setMinimumContentsLength(this->itemText(index).length());
-            }
-        });
-    index++;
-
     this->addItem(paragraphCountText(0));
-    this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
-    this->connect(documentStats,
-        &DocumentStatistics::paragraphCountChanged,
-        this,
-        [this, index](int value) {
-            this->setItemText(index,
-                paragraphCountText(value));
-
-            if (index == this->currentIndex()) {
-                this->setMinimumContentsLength(this->itemText(index).length());
-            }
-        });
-    index++;
-
     this->addItem(pageCountText(0));
-    this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
-    this->connect(documentStats,
-        &DocumentStatistics::pageCountChanged,
-        this,
-        [this, index](int value) {
-            this->setItemText(index,
-                pageCountText(value));
+    this->addItem(readTimeText(0));
 
-            if (index == this->currentIndex()) {
-                this->setMinimumContentsLength(this->itemText(index).length());
-            }
-        });
-    index++;
+    for (; index < this->count(); index++) {
+        this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
+    }
 
-    this->addItem(readTimeText(0));
-    this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
     this->connect(documentStats,
-        &DocumentStatistics::readingTimeChanged,
+        &DocumentStatistics::statisticsChanged,
         this,
-        [this, index](int minutes) {
-            this->setItemText(index,
-                readTimeText(minutes));
-
-            if (index == this->currentIndex()) {
-                this->setMinimumContentsLength(this->itemText(index).length());
+        [this, index](const DocumentStatisticsData &statistics) {
+            this->setItemText(0, wordCountText(statistics.wordCount));
+            this->setItemText(1, characterCountText(statistics.characterCount));
+            this->setItemText(2, sentenceCountText(statistics.sentenceCount));
+            this->setItemText(3, paragraphCountText(statistics.paragraphCount));
+            this->setItemText(4, pageCountText(statistics.pageCount));
+            this->setItemText(5, readTimeText(statistics.readingTime));
+
+            if (this->currentIndex() < index) {
+                this->setMinimumContentsLength(this->currentText().length());
             }
         });
-    index++;
 
     this->addItem(wordsAddedText(0));
     this->setItemData(index, Qt::AlignCenter, Qt::TextAlignmentRole);
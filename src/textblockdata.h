@@ -20,54 +20,165 @@
 #ifndef TEXTBLOCKDATA_H
 #define TEXTBLOCKDATA_H
 
-#include <QObject>
-#include <QTextBlock>
 #include <QTextBlockUserData>
-
-#include "markdowndocument.h"
+#include <QVector>
 
 namespace ghostwriter
 {
 /**
- * User data for use with the MarkdownHighlighter and DocumentStatistics.
+ * Statistics of a block of text, or the running totals of the statistics
+ * of all the blocks in a document.
+ */
+typedef struct TextBlockStatistics
+{
+    int wordCount;
+    int alphaNumericCharacterCount;
+    int sentenceCount;
+    int lixLongWordCount;
+    int paragraphCount;
+} TextBlockStatistics;
+
+/**
+ * Metadata cached for a text block, for use with DocumentStatistics.
  */
-class TextBlockData : public QObject, public QTextBlockUserData
+typedef struct TextBlockMetadata
 {
-    Q_OBJECT
+    TextBlockStatistics statistics;
+
+    // Hash of the block's text when it was last counted, so that blocks
+    // whose formatting alone changed are not counted again.
+    //
+    uint textHash;
 
+    // Revision of the block's text, and the revision for which the
+    // sentences were last counted, since sentences are counted in the
+    // background.  Revisions are never reused, and are zero for metadata
+    // of removed blocks.
+    //
+    quint64 revision;
+    quint64 sentenceRevision;
+} TextBlockMetadata;
+
+/**
+ * Contiguous table of the metadata of a document's blocks, indexed by the
+ * ids handed out to the blocks' TextBlockData.  Ids of removed blocks are
+ * reused.  Also keeps the running totals of the blocks' statistics.
+ */
+class TextBlockMetadataTable
+{
 public:
     /**
      * Constructor.
      */
-    TextBlockData(MarkdownDocument *document, const QTextBlock &block)
-        : document(document), blockRef(block)
+    TextBlockMetadataTable()
     {
-        wordCount = 0;
-        alphaNumericCharacterCount = 0;
-        sentenceCount = 0;
-        lixLongWordCount = 0;
+        clearTotals();
     }
 
     /**
-     * Destructor.
+     * Allocates metadata for a new block, returning its id.
      */
-    virtual ~TextBlockData()
+    int allocate()
+    {
+        int id;
+
+        if (freeIds.isEmpty()) {
+            id = records.size();
+            records.append(TextBlockMetadata());
+        } else {
+            id = freeIds.takeLast();
+        }
+
+        records[id] = TextBlockMetadata();
+        return id;
+    }
+
+    /**
+     * Releases the metadata of a removed block, taking its statistics out
+     * of the totals.
+     */
+    void release(int id)
+    {
+        TextBlockMetadata &metadata = records[id];
+
+        totals.wordCount -= metadata.statistics.wordCount;
+        totals.alphaNumericCharacterCount -= metadata.statistics.alphaNumericCharacterCount;
+        totals.sentenceCount -= metadata.statistics.sentenceCount;
+        totals.lixLongWordCount -= metadata.statistics.lixLongWordCount;
+        totals.paragraphCount -= metadata.statistics.paragraphCount;
+
+        metadata.revision = 0;
+        freeIds.append(id);
+    }
+
+    /**
+     * Returns the metadata of the block with the given id.
+     */
+    TextBlockMetadata &operator[](int id)
+    {
+        return records[id];
+    }
+
+    /**
+     * Sets the running totals to zero.
+     */
+    void clearTotals()
+    {
+        totals.wordCount = 0;
+        totals.alphaNumericCharacterCount = 0;
+        totals.sentenceCount = 0;
+        totals.lixLongWordCount = 0;
+        totals.paragraphCount = 0;
+    }
+
+    /**
+     * Running totals of the statistics of the blocks in the table.  Note
+     * that alphaNumericCharacterCount counts "word" characters.
+     */
+    TextBlockStatistics totals;
+
+private:
+    QVector<TextBlockMetadata> records;
+    QVector<int> freeIds;
+};
+
+/**
+ * User data for use with DocumentStatistics.  Only refers to the block's
+ * metadata within a TextBlockMetadataTable, which is released once the
+ * block is removed from the document and its user data deleted.
+ */
+class TextBlockData : public QTextBlockUserData
+{
+public:
+    /**
+     * Constructor.  Allocates metadata for the block from the given table.
+     */
+    TextBlockData(TextBlockMetadataTable *table)
+        : table(table), id(table->allocate())
     {
         ;
     }
 
-    MarkdownDocument *document;
+    /**
+     * Destructor.
+     */
+    virtual ~TextBlockData()
+    {
+        if (nullptr != table) {
+            table->release(id);
+        }
+    }
 
-    int wordCount;
-    int alphaNumericCharacterCount;
-    int sentenceCount;
-    int lixLongWordCount;
+    /**
+     * Table holding the block's metadata, or null if the table no longer
+     * exists.
+     */
+    TextBlockMetadataTable *table;
 
     /**
-     * Parent text block.  For use with fetching the block's document
-     * position, which can shift as text is inserted and deleted.
+     * Id of the block's metadata within the table.
      */
-    QTextBlock blockRef;
+    const int id;
 };
 } // namespace ghostwriter
 
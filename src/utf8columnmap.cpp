@@ -0,0 +1,169 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <algorithm>
+
+#include <QChar>
+
+#include "utf8columnmap.h"
+
+namespace ghostwriter
+{
+Utf8ColumnMap::Utf8ColumnMap()
+{
+    lineRuns.append(0);
+}
+
+Utf8ColumnMap::Utf8ColumnMap(const QString &text)
+{
+    setText(text);
+}
+
+Utf8ColumnMap::~Utf8ColumnMap()
+{
+    ;
+}
+
+void Utf8ColumnMap::setText(const QString &text)
+{
+    lineRuns.clear();
+    runs.clear();
+    lineRuns.append(0);
+
+    const QChar *data = text.constData();
+    const int length = text.length();
+    int byteOffset = 0;
+    int utf16Offset = 0;
+
+    // Width of the current run's characters.  Lines start out as ASCII.
+    quint8 runByteLength = 1;
+    quint8 runUtf16Length = 1;
+
+    for (int i = 0; i < length; i++) {
+        ushort c = data[i].unicode();
+
+        // Break lines the same way cmark-gfm does.
+        if (('\n' == c) || ('\r' == c)) {
+            if (('\r' == c) && ((i + 1) < length) && ('\n' == data[i + 1])) {
+                i++;
+            }
+
+            lineRuns.append(runs.size());
+            byteOffset = 0;
+            utf16Offset = 0;
+            runByteLength = 1;
+            runUtf16Length = 1;
+            continue;
+        }
+
+        quint8 byteLength;
+        quint8 utf16Length = 1;
+
+        if (0 == c) {
+            // cmark-gfm replaces null characters with U+FFFD.
+            byteLength = 3;
+        } else if (c < 0x80) {
+            byteLength = 1;
+        } else if (c < 0x800) {
+            byteLength = 2;
+        } else if (QChar::isHighSurrogate(c)
+                && ((i + 1) < length)
+                && data[i + 1].isLowSurrogate()) {
+            byteLength = 4;
+            utf16Length = 2;
+            i++;
+        } else if (QChar::isSurrogate(c)) {
+            // Unpaired surrogates are encoded as a single '?'.
+            byteLength = 1;
+        } else {
+            byteLength = 3;
+        }
+
+        if ((byteLength != runByteLength) || (utf16Length != runUtf16Length)) {
+            Run run;
+            run.byteOffset = byteOffset;
+            run.utf16Offset = utf16Offset;
+            run.byteLength = byteLength;
+            run.utf16Length = utf16Length;
+            runs.append(run);
+
+            runByteLength = byteLength;
+            runUtf16Length = utf16Length;
+        }
+
+        byteOffset += byteLength;
+        utf16Offset += utf16Length;
+    }
+
+    lineRuns.append(runs.size());
+}
+
+int Utf8ColumnMap::lineCount() const
+{
+    return lineRuns.size() - 1;
+}
+
+bool Utf8ColumnMap::isAsciiLine(int line) const
+{
+    if ((line < 1) || (line > lineCount())) {
+        return true;
+    }
+
+    return lineRuns[line - 1] == lineRuns[line];
+}
+
+int Utf8ColumnMap::utf16Offset(int line, int byteOffset, bool roundUp) const
+{
+    if ((byteOffset <= 0) || isAsciiLine(line)) {
+        return byteOffset;
+    }
+
+    QVector<Run>::const_iterator begin = runs.constBegin() + lineRuns[line - 1];
+    QVector<Run>::const_iterator end = runs.constBegin() + lineRuns[line];
+
+    // Find the last run starting at or before the byte offset.
+    QVector<Run>::const_iterator run =
+        std::upper_bound
+        (
+            begin,
+            end,
+            byteOffset,
+            [](int offset, const Run &run) {
+                return offset < run.byteOffset;
+            }
+        );
+
+    if (begin == run) {
+        return byteOffset;
+    }
+
+    run--;
+
+    int bytesIntoRun = byteOffset - run->byteOffset;
+    int characters = bytesIntoRun / run->byteLength;
+    int bytesIntoCharacter = bytesIntoRun % run->byteLength;
+    int offset = run->utf16Offset + (characters * run->utf16Length);
+
+    if (roundUp && (bytesIntoCharacter > 0)) {
+        offset += run->utf16Length;
+    }
+
+    return offset;
+}
+} // namespace ghostwriter
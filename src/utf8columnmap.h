@@ -0,0 +1,111 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef UTF8_COLUMN_MAP_H
+#define UTF8_COLUMN_MAP_H
+
+#include <QString>
+#include <QVector>
+
+namespace ghostwriter
+{
+/**
+ * Maps byte offsets within the lines of UTF-8 encoded text to UTF-16
+ * offsets within the same lines of the original QString.  Use this class
+ * to translate the column numbers that cmark-gfm reports (which count
+ * bytes) into positions within a QTextBlock.
+ *
+ * Only the points within a line where the width of its characters
+ * changes are stored, as runs of characters that are encoded with the
+ * same number of bytes.  Lines that contain nothing but ASCII characters
+ * therefore need no runs, and their byte offsets are returned unchanged,
+ * while lines of uniform non-ASCII text need only one.
+ */
+class Utf8ColumnMap
+{
+public:
+    /**
+     * Constructor.  Creates an empty map, for which all byte offsets
+     * are returned unchanged.
+     */
+    Utf8ColumnMap();
+
+    /**
+     * Constructor.  Builds the map for the given text.
+     */
+    Utf8ColumnMap(const QString &text);
+
+    /**
+     * Destructor.
+     */
+    ~Utf8ColumnMap();
+
+    /**
+     * Rebuilds the map for the given text.
+     */
+    void setText(const QString &text);
+
+    /**
+     * Returns the number of lines in the mapped text.
+     */
+    int lineCount() const;
+
+    /**
+     * Returns true if the given line (starting at 1) contains only
+     * ASCII characters.
+     */
+    bool isAsciiLine(int line) const;
+
+    /**
+     * Returns the UTF-16 offset within the given line (starting at 1)
+     * for the given byte offset (starting at 0) into the UTF-8 encoding
+     * of that line.  Byte offsets that fall within a multi-byte character
+     * are mapped to the start of that character, or to its end if roundUp
+     * is true.  Offsets for lines outside of the text are returned
+     * unchanged.
+     */
+    int utf16Offset(int line, int byteOffset, bool roundUp = false) const;
+
+private:
+    /*
+     * A run of characters that are each encoded with the given number of
+     * UTF-8 bytes and UTF-16 code units.  The run lasts until the start
+     * of the next run of the same line, or until the end of the line.
+     * Offsets are relative to the start of the run's line.  Characters
+     * before the first run of a line are ASCII.
+     */
+    typedef struct
+    {
+        int byteOffset;
+        int utf16Offset;
+        quint8 byteLength;
+        quint8 utf16Length;
+    } Run;
+
+    // Index into runs of the first run of each line, followed by the
+    // total number of runs.  The runs of line n (starting at 1) are thus
+    // in the range [lineRuns[n - 1], lineRuns[n]), which is empty for an
+    // ASCII line.
+    //
+    QVector<int> lineRuns;
+    QVector<Run> runs;
+};
+} // namespace ghostwriter
+
+#endif
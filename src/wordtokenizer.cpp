@@ -0,0 +1,263 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QChar>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "wordtokenizer.h"
+
+namespace ghostwriter
+{
+namespace
+{
+enum CharClass
+{
+    OtherClass,
+    SpaceClass,
+    JoinerClass,
+    WordClass
+};
+
+/*
+ * Classifies the given character, adding the WordTokenizer::TokenFlags
+ * of word characters to the given flags.
+ */
+inline CharClass classify(const ushort c, int &flags)
+{
+    if (c < 0x80) {
+        if ((c >= 'a') && (c <= 'z')) {
+            flags |= WordTokenizer::LowercaseFlag;
+            return WordClass;
+        } else if ((c >= 'A') && (c <= 'Z')) {
+            return WordClass;
+        } else if ((c >= '0') && (c <= '9')) {
+            flags |= WordTokenizer::NumberFlag;
+            return WordClass;
+        } else if ((' ' == c) || ((c >= '\t') && (c <= '\r'))) {
+            return SpaceClass;
+        } else if (('-' == c) || ('.' == c) || ('\'' == c)) {
+            return JoinerClass;
+        }
+
+        return OtherClass;
+    }
+
+    QChar ch(c);
+
+    if (ch.isLetterOrNumber() || ch.isMark()) {
+        if (ch.isNumber()) {
+            flags |= WordTokenizer::NumberFlag;
+        } else if (ch.isLower()) {
+            flags |= WordTokenizer::LowercaseFlag;
+        }
+
+        return WordClass;
+    } else if (ch.isSpace()) {
+        return SpaceClass;
+    } else if (0x2019 == c) {
+        // Right single quotation mark, used as an apostrophe.
+        return JoinerClass;
+    }
+
+    return OtherClass;
+}
+
+#ifdef __SSE2__
+/*
+ * Skips past ASCII letters from the given index, eight at a time,
+ * stopping before the first group of eight that holds anything else.
+ * Returns the index of the first character not skipped.
+ */
+inline int skipAsciiLetters(const ushort *data, int i, const int length, int &flags)
+{
+    const __m128i a = _mm_set1_epi16('a');
+    const __m128i caseBit = _mm_set1_epi16(0x20);
+    const __m128i minusOne = _mm_set1_epi16(-1);
+    const __m128i alphabetLength = _mm_set1_epi16(26);
+
+    while ((i + 8) <= length) {
+        __m128i chars = _mm_loadu_si128((const __m128i *) (data + i));
+
+        // Offsets from 'a' are within [0, 26) for lowercase letters, and
+        // likewise for uppercase letters once their case bit is set.
+        // Anything at or above 0x8000 has a negative or too large offset.
+        //
+        __m128i lowerOffset = _mm_sub_epi16(chars, a);
+        __m128i letterOffset = _mm_sub_epi16(_mm_or_si128(chars, caseBit), a);
+
+        __m128i isLetter =
+            _mm_and_si128
+            (
+                _mm_cmpgt_epi16(letterOffset, minusOne),
+                _mm_cmplt_epi16(letterOffset, alphabetLength)
+            );
+
+        if (0xFFFF != _mm_movemask_epi8(isLetter)) {
+            break;
+        }
+
+        __m128i isLower =
+            _mm_and_si128
+            (
+                _mm_cmpgt_epi16(lowerOffset, minusOne),
+                _mm_cmplt_epi16(lowerOffset, alphabetLength)
+            );
+
+        if (0 != _mm_movemask_epi8(isLower)) {
+            flags |= WordTokenizer::LowercaseFlag;
+        }
+
+        i += 8;
+    }
+
+    return i;
+}
+#endif
+} // namespace
+
+WordTokenizer::WordTokenizer(const QString &text, int position)
+    : text(text), position(qMax(position, 0)), lastWordEnd(-1)
+{
+    ;
+}
+
+WordTokenizer::~WordTokenizer()
+{
+    ;
+}
+
+bool WordTokenizer::next(WordToken &token)
+{
+    const ushort *data = text.utf16();
+    const int length = text.length();
+    int flags = 0;
+    int i = position;
+
+    // Find the start of the word.
+    while ((i < length) && (WordClass != classify(data[i], flags))) {
+        i++;
+    }
+
+    if (i >= length) {
+        position = length;
+        return false;
+    }
+
+    int start = i;
+    int end = ++i;
+
+    // Find the end of the word, which includes single joiners between
+    // runs of word characters.
+    //
+    while (i < length) {
+#ifdef __SSE2__
+        i = skipAsciiLetters(data, i, length, flags);
+        end = i;
+
+        if (i >= length) {
+            break;
+        }
+#endif
+
+        CharClass charClass = classify(data[i], flags);
+
+        if (WordClass == charClass) {
+            end = ++i;
+        } else if
+        (
+            (JoinerClass == charClass) &&
+            ((i + 1) < length) &&
+            (WordClass == classify(data[i + 1], flags))
+        ) {
+            i += 2;
+            end = i;
+        } else {
+            break;
+        }
+    }
+
+    int separatorFlags = 0;
+
+    if
+    (
+        (lastWordEnd >= 0) &&
+        (start == (lastWordEnd + 1)) &&
+        (SpaceClass != classify(data[lastWordEnd], separatorFlags))
+    ) {
+        flags |= JoinedFlag;
+    }
+
+    token.position = start;
+    token.length = end - start;
+    token.flags = flags;
+
+    position = end;
+    lastWordEnd = end;
+
+    return true;
+}
+
+void WordTokenizer::countWords
+(
+    const QString &text,
+    int &words,
+    int &longWords,
+    int &wordCharacters
+)
+{
+    WordTokenizer tokenizer(text);
+    WordToken token;
+    int wordStart = -1;
+    int wordEnd = -1;
+
+    words = 0;
+    longWords = 0;
+    wordCharacters = 0;
+
+    forever {
+        bool found = tokenizer.next(token);
+
+        if (found && (wordStart >= 0) && (token.flags & JoinedFlag)) {
+            wordEnd = token.position + token.length;
+            continue;
+        }
+
+        if (wordStart >= 0) {
+            int wordLength = wordEnd - wordStart;
+
+            words++;
+            wordCharacters += wordLength;
+
+            if (wordLength > 6) {
+                longWords++;
+            }
+        }
+
+        if (!found) {
+            break;
+        }
+
+        wordStart = token.position;
+        wordEnd = token.position + token.length;
+    }
+}
+} // namespace ghostwriter
@@ -0,0 +1,109 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2020 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef WORD_TOKENIZER_H
+#define WORD_TOKENIZER_H
+
+#include <QString>
+
+namespace ghostwriter
+{
+/**
+ * A word found by the WordTokenizer, given by its position and length
+ * within the tokenized text, along with WordTokenizer::TokenFlags
+ * describing it.
+ */
+typedef struct WordToken
+{
+    int position;
+    int length;
+    int flags;
+} WordToken;
+
+/**
+ * Splits text into words for spell checking and for counting words.
+ *
+ * A word is a run of letters, numbers and marks.  Runs joined by a single
+ * hyphen, period or apostrophe (such as "well-known" or "don't") form a
+ * single word.  Words separated by exactly one other character that is
+ * not whitespace (such as "and/or") are flagged as joined to the word
+ * before them, so that they can be counted as one word while still being
+ * spell checked apart.
+ *
+ * ASCII characters are classified with simple range comparisons, and runs
+ * of ASCII letters are skipped several characters at a time where SIMD is
+ * available.  Unicode character properties are only consulted for other
+ * characters.
+ */
+class WordTokenizer
+{
+public:
+    enum TokenFlag
+    {
+        // The word follows the prior word with only a single character
+        // that is not whitespace between them.
+        JoinedFlag = 0x1,
+
+        // The word contains a number.
+        NumberFlag = 0x2,
+
+        // The word contains a lowercase letter.
+        LowercaseFlag = 0x4
+    };
+
+    /**
+     * Constructor.  Tokenizes the given text, starting from the given
+     * position.  The text must outlive the tokenizer.
+     */
+    WordTokenizer(const QString &text, int position = 0);
+
+    /**
+     * Destructor.
+     */
+    ~WordTokenizer();
+
+    /**
+     * Finds the next word in the text.  Returns false if there are
+     * no more words.
+     */
+    bool next(WordToken &token);
+
+    /**
+     * Counts the words of the given text, with words joined by a
+     * separator (see JoinedFlag) counted as one.  Also returns the
+     * number of words that are longer than six characters, and the
+     * number of characters (including separators within a word) that
+     * make up the words.
+     */
+    static void countWords
+    (
+        const QString &text,
+        int &words,
+        int &longWords,
+        int &wordCharacters
+    );
+
+private:
+    const QString &text;
+    int position;
+    int lastWordEnd;
+};
+} // namespace ghostwriter
+
+#endif // WORD_TOKENIZER_H